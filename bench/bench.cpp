@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "Auxiliary.h"
+#include "FacilityCatalog.h"
+#include "Plan.h"
+#include "SelectionPolicy.h"
+#include "Settlement.h"
+#include "Simulation.h"
+using std::string;
+using std::vector;
+
+/*
+Times the hot paths one at a time. Every benchmark runs a warm-up sample and then a
+fixed number of timed samples, each doing the same number of operations, and reports
+the median and 99th percentile time per operation over the samples. Results are
+written as JSON so runs of different versions can be compared.
+
+Usage: bench [--samples N] [--max-catalog N] [--output file] [--filter text]
+*/
+
+// Defined by main.cpp in the simulation itself; the backup actions refer to it.
+Simulation* backup = nullptr;
+
+struct Result {
+    Result(const string &name, long long parameter, long long opsPerSample, int samples)
+        : name(name), parameter(parameter), opsPerSample(opsPerSample), samples(samples),
+          medianNs(0), p99Ns(0), opsPerSecond(0) {}
+    string name;
+    long long parameter;
+    long long opsPerSample;
+    int samples;
+    double medianNs;
+    double p99Ns;
+    double opsPerSecond;
+};
+
+struct Options {
+    Options() : samples(15), maxCatalog(1000000), outputPath(), filter() {}
+    int samples;
+    int maxCatalog;
+    string outputPath;
+    string filter;
+};
+
+// Results are folded into this so the compiler can't drop the work being timed.
+static volatile long long sink = 0;
+
+static double percentile(vector<double> sorted, double fraction) {
+    std::sort(sorted.begin(), sorted.end());
+    size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+/*
+sample does opsPerSample operations. Whatever it needs to set up before the clock
+starts goes in prepare, which runs before every sample.
+*/
+static void measure(const Options &options, vector<Result> &results, const string &name, long long parameter,
+                    long long opsPerSample, const std::function<void()> &prepare, const std::function<void()> &sample) {
+    if (!options.filter.empty() && name.find(options.filter) == string::npos) {
+        return;
+    }
+
+    vector<double> perOp;
+    for (int i = 0; i <= options.samples; i++) {
+        prepare();
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        sample();
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        if (i > 0) {
+            double ns = std::chrono::duration<double, std::nano>(end - begin).count();
+            perOp.push_back(ns / opsPerSample);
+        }
+    }
+
+    Result result(name, parameter, opsPerSample, options.samples);
+    result.medianNs = percentile(perOp, 0.5);
+    result.p99Ns = percentile(perOp, 0.99);
+    result.opsPerSecond = result.medianNs > 0 ? 1e9 / result.medianNs : 0;
+    results.push_back(result);
+
+    std::cerr << name << " [" << parameter << "]: median " << result.medianNs << " ns/op, p99 "
+              << result.p99Ns << " ns/op\n";
+}
+
+static void noSetup() {}
+
+static FacilityCatalog makeCatalog(int size) {
+    FacilityCatalog catalog;
+    catalog.reserve(size);
+    for (int i = 0; i < size; i++) {
+        catalog.add(FacilityType("F" + std::to_string(i), static_cast<FacilityCategory>(i % 3), 1 + i % 5,
+                                 i % 7, (i * 3) % 11, (i * 5) % 13));
+    }
+    return catalog;
+}
+
+/*
+Writes a configuration file with the given number of settlements, facility types and
+plans and returns its path. The caller removes it.
+*/
+static string writeConfig(int numOfSettlements, int numOfFacilities, int numOfPlans) {
+    char path[] = "/tmp/benchconfigXXXXXX";
+    int descriptor = mkstemp(path);
+    if (descriptor < 0) {
+        throw std::runtime_error("Failed to create a temporary configuration file");
+    }
+    close(descriptor);
+
+    std::ofstream file(path);
+    for (int i = 0; i < numOfSettlements; i++) {
+        file << "settlement S" << i << " " << i % 3 << "\n";
+    }
+    for (int i = 0; i < numOfFacilities; i++) {
+        file << "facility F" << i << " " << i % 3 << " " << 1 + i % 5 << " " << i % 7 << " "
+             << (i * 3) % 11 << " " << (i * 5) % 13 << "\n";
+    }
+    const char *policies[] = {"nve", "bal", "eco", "env"};
+    for (int i = 0; i < numOfPlans; i++) {
+        file << "plan S" << i % numOfSettlements << " " << policies[i % 4] << "\n";
+    }
+    return path;
+}
+
+// Caps 1 to 3 are the settlement types' defaults; the larger ones come from configuration files.
+static void benchPlanStep(const Options &options, vector<Result> &results) {
+    const FacilityCatalog catalog = makeCatalog(100);
+    const int caps[] = {1, 2, 3, 100, 1000, 10000};
+    for (int cap : caps) {
+        const int steps = std::max(100, 20000 / cap);
+        const std::shared_ptr<const Settlement> settlement = std::make_shared<Settlement>("S", SettlementType::METROPOLIS, cap);
+        Plan *plan = nullptr;
+        measure(options, results, "plan_step_cap", cap, steps,
+            [&] {
+                delete plan;
+                plan = new Plan(0, settlement, new NaiveSelection());
+            },
+            [&] {
+                for (int i = 0; i < steps; i++) {
+                    plan->step(catalog);
+                }
+                sink += plan->getlifeQualityScore();
+            });
+        delete plan;
+    }
+}
+
+// The whole step loop per policy, selection included, at the city cap.
+static void benchPlanStepPolicy(const Options &options, vector<Result> &results) {
+    const char *names[] = {"plan_step_naive", "plan_step_balanced", "plan_step_economy", "plan_step_sustainability"};
+    const FacilityCatalog catalog = makeCatalog(100);
+    const int steps = 20000;
+    const std::shared_ptr<const Settlement> settlement = std::make_shared<Settlement>("S", SettlementType::CITY);
+    for (int kind = 0; kind < 4; kind++) {
+        Plan *plan = nullptr;
+        measure(options, results, names[kind], 100, steps,
+            [&] {
+                delete plan;
+                plan = new Plan(0, settlement, SelectionPolicy::create(kind, 0, 0, 0));
+            },
+            [&] {
+                for (int i = 0; i < steps; i++) {
+                    plan->step(catalog);
+                }
+                sink += plan->getlifeQualityScore();
+            });
+        delete plan;
+    }
+}
+
+// Each policy one selection at a time, then in batches of BATCH as a plan refills its slots.
+static void benchSelectFacility(const Options &options, vector<Result> &results) {
+    const char *names[] = {"select_naive", "select_balanced", "select_economy", "select_sustainability"};
+    const char *batchNames[] = {"select_batch_naive", "select_batch_balanced", "select_batch_economy", "select_batch_sustainability"};
+    const int selections = 100000;
+    const int BATCH = 100;
+    vector<int> selected;
+    for (long long size = 10; size <= options.maxCatalog; size *= 10) {
+        const FacilityCatalog catalog = makeCatalog(static_cast<int>(size));
+        for (int kind = 0; kind < 4; kind++) {
+            SelectionPolicy *policy = nullptr;
+            measure(options, results, names[kind], size, selections,
+                [&] {
+                    delete policy;
+                    policy = SelectionPolicy::create(kind, 0, 0, 0);
+                },
+                [&] {
+                    for (int i = 0; i < selections; i++) {
+                        sink += policy->selectFacility(catalog).getCost();
+                    }
+                });
+            measure(options, results, batchNames[kind], size, selections,
+                [&] {
+                    delete policy;
+                    policy = SelectionPolicy::create(kind, 0, 0, 0);
+                },
+                [&] {
+                    for (int i = 0; i < selections; i += BATCH) {
+                        selected.clear();
+                        policy->selectFacilities(catalog, BATCH, selected);
+                        sink += selected.back();
+                    }
+                });
+            delete policy;
+        }
+    }
+}
+
+static void benchSimulationCopy(const Options &options, vector<Result> &results) {
+    for (int numOfPlans = 1000; numOfPlans <= 100000; numOfPlans *= 10) {
+        string path = writeConfig(100, 200, numOfPlans);
+        Simulation simulation(path);
+        std::remove(path.c_str());
+        simulation.advance(10);
+
+        const int copies = 100;
+        measure(options, results, "simulation_copy_construct", numOfPlans, copies, noSetup,
+            [&] {
+                for (int i = 0; i < copies; i++) {
+                    Simulation copy(simulation);
+                    sink += copy.getNumOfPlans();
+                }
+            });
+
+        Simulation restored(simulation);
+        measure(options, results, "simulation_copy_assign", numOfPlans, copies, noSetup,
+            [&] {
+                for (int i = 0; i < copies; i++) {
+                    restored = simulation;
+                    sink += restored.getNumOfPlans();
+                }
+            });
+    }
+}
+
+static void benchConfigParsing(const Options &options, vector<Result> &results) {
+    for (int numOfPlans = 1000; numOfPlans <= 1000000; numOfPlans *= 10) {
+        string path = writeConfig(100, 1000, numOfPlans);
+        long long lines = 100 + 1000 + numOfPlans;
+        measure(options, results, "config_parse_lines", lines, lines, noSetup,
+            [&] {
+                Simulation simulation(path);
+                sink += simulation.getNumOfPlans();
+            });
+        std::remove(path.c_str());
+    }
+}
+
+static void benchParseArguments(const Options &options, vector<Result> &results) {
+    const string lines[] = {
+        "step 1",
+        "plan SettlementName eco",
+        "facility SomeFacilityName 1 3 2 1 4",
+    };
+    const int parses = 100000;
+    for (const string &line : lines) {
+        long long words = Auxiliary::parseArguments(line).size();
+        measure(options, results, "parse_arguments_words", words, parses, noSetup,
+            [&] {
+                for (int i = 0; i < parses; i++) {
+                    sink += Auxiliary::parseArguments(line).size();
+                }
+            });
+    }
+}
+
+static void writeJson(std::ostream &out, const vector<Result> &results) {
+    out << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &result = results[i];
+        out << "    {\"name\": \"" << result.name << "\", \"parameter\": " << result.parameter
+            << ", \"ops_per_sample\": " << result.opsPerSample << ", \"samples\": " << result.samples
+            << ", \"median_ns\": " << result.medianNs << ", \"p99_ns\": " << result.p99Ns
+            << ", \"ops_per_second\": " << result.opsPerSecond << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+static bool parseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; i++) {
+        string flag = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        string value = argv[++i];
+        if (flag == "--samples") {
+            options.samples = std::atoi(value.c_str());
+        } else if (flag == "--max-catalog") {
+            options.maxCatalog = std::atoi(value.c_str());
+        } else if (flag == "--output") {
+            options.outputPath = value;
+        } else if (flag == "--filter") {
+            options.filter = value;
+        } else {
+            return false;
+        }
+    }
+    return options.samples > 0 && options.maxCatalog > 0;
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: bench [--samples N] [--max-catalog N] [--output file] [--filter text]\n";
+        return 1;
+    }
+
+    vector<Result> results;
+    benchPlanStep(options, results);
+    benchPlanStepPolicy(options, results);
+    benchSelectFacility(options, results);
+    benchSimulationCopy(options, results);
+    benchConfigParsing(options, results);
+    benchParseArguments(options, results);
+
+    if (options.outputPath.empty()) {
+        writeJson(std::cout, results);
+    } else {
+        std::ofstream file(options.outputPath);
+        writeJson(file, results);
+        if (!file) {
+            std::cerr << "Failed to write " << options.outputPath << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
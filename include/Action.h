@@ -1,6 +1,8 @@
 #pragma once
 #include <string>
 #include <vector>
+#include "Binary.h"
+#include "OutputBuffer.h"
 class Simulation;
 enum class SettlementType;
 enum class FacilityCategory;
@@ -16,11 +18,15 @@ class BaseAction{
         BaseAction();
         ActionStatus getStatus() const;
         virtual void act(Simulation& simulation)=0;
-        virtual const string toString() const=0;
+        const string toString() const;
+        virtual void print(OutputBuffer &out) const = 0;
         virtual BaseAction* clone() const = 0;
         virtual ~BaseAction() = default;
+        void save(BinaryWriter &writer) const;
+        static BaseAction* load(BinaryReader &reader);
 
     protected:
+        virtual void saveArguments(BinaryWriter &writer) const = 0;
         void complete();
         void error(string errorMsg);
         const string &getErrorMsg() const;
@@ -35,8 +41,10 @@ class SimulateStep : public BaseAction {
     public:
         SimulateStep(const int numOfSteps);
         void act(Simulation &simulation) override;
-        const string toString() const override;
+        void print(OutputBuffer &out) const override;
         SimulateStep *clone() const override;
+    protected:
+        void saveArguments(BinaryWriter &writer) const override;
     private:
         const int numOfSteps;
 };
@@ -45,8 +53,10 @@ class AddPlan : public BaseAction {
     public:
         AddPlan(const string &settlementName, const string &selectionPolicy);
         void act(Simulation &simulation) override;
-        const string toString() const override;
+        void print(OutputBuffer &out) const override;
         AddPlan *clone() const override;
+    protected:
+        void saveArguments(BinaryWriter &writer) const override;
     private:
         const string settlementName;
         const string selectionPolicy;
@@ -58,7 +68,9 @@ class AddSettlement : public BaseAction {
         AddSettlement(const string &settlementName,SettlementType settlementType);
         void act(Simulation &simulation) override;
         AddSettlement *clone() const override;
-        const string toString() const override;
+        void print(OutputBuffer &out) const override;
+    protected:
+        void saveArguments(BinaryWriter &writer) const override;
     private:
         const string settlementName;
         const SettlementType settlementType;
@@ -71,7 +83,9 @@ class AddFacility : public BaseAction {
         AddFacility(const string &facilityName, const FacilityCategory facilityCategory, const int price, const int lifeQualityScore, const int economyScore, const int environmentScore);
         void act(Simulation &simulation) override;
         AddFacility *clone() const override;
-        const string toString() const override;
+        void print(OutputBuffer &out) const override;
+    protected:
+        void saveArguments(BinaryWriter &writer) const override;
     private:
         const string facilityName;
         const FacilityCategory facilityCategory;
@@ -87,7 +101,9 @@ class PrintPlanStatus: public BaseAction {
         PrintPlanStatus(int planId);
         void act(Simulation &simulation) override;
         PrintPlanStatus *clone() const override;
-        const string toString() const override;
+        void print(OutputBuffer &out) const override;
+    protected:
+        void saveArguments(BinaryWriter &writer) const override;
     private:
         const int planId;
 };
@@ -98,7 +114,9 @@ class ChangePlanPolicy : public BaseAction {
         ChangePlanPolicy(const int planId, const string &newPolicy);
         void act(Simulation &simulation) override;
         ChangePlanPolicy *clone() const override;
-        const string toString() const override;
+        void print(OutputBuffer &out) const override;
+    protected:
+        void saveArguments(BinaryWriter &writer) const override;
     private:
         const int planId;
         const string newPolicy;
@@ -110,7 +128,9 @@ class PrintActionsLog : public BaseAction {
         PrintActionsLog();
         void act(Simulation &simulation) override;
         PrintActionsLog *clone() const override;
-        const string toString() const override;
+        void print(OutputBuffer &out) const override;
+    protected:
+        void saveArguments(BinaryWriter &writer) const override;
     private:
 };
 
@@ -119,25 +139,87 @@ class Close : public BaseAction {
         Close();
         void act(Simulation &simulation) override;
         Close *clone() const override;
-        const string toString() const override;
+        void print(OutputBuffer &out) const override;
+    protected:
+        void saveArguments(BinaryWriter &writer) const override;
+    private:
+};
+
+class PrintStats : public BaseAction {
+    public:
+        PrintStats(const string &format);
+        void act(Simulation &simulation) override;
+        PrintStats *clone() const override;
+        void print(OutputBuffer &out) const override;
+    protected:
+        void saveArguments(BinaryWriter &writer) const override;
     private:
+        const string format;
+};
+
+class OptimizePlan : public BaseAction {
+    public:
+        OptimizePlan(const int planId, const int horizon, const string &objective);
+        void act(Simulation &simulation) override;
+        OptimizePlan *clone() const override;
+        void print(OutputBuffer &out) const override;
+    protected:
+        void saveArguments(BinaryWriter &writer) const override;
+    private:
+        const int planId;
+        const int horizon;
+        const string objective;
+};
+
+class TopPlans : public BaseAction {
+    public:
+        TopPlans(const string &metric, const int count);
+        void act(Simulation &simulation) override;
+        TopPlans *clone() const override;
+        void print(OutputBuffer &out) const override;
+    protected:
+        void saveArguments(BinaryWriter &writer) const override;
+    private:
+        const string metric;
+        const int count;
+};
+
+class AggregatePlans : public BaseAction {
+    public:
+        AggregatePlans(const string &metric, const string &grouping);
+        void act(Simulation &simulation) override;
+        AggregatePlans *clone() const override;
+        void print(OutputBuffer &out) const override;
+    protected:
+        void saveArguments(BinaryWriter &writer) const override;
+    private:
+        const string metric;
+        const string grouping;
 };
 
 class BackupSimulation : public BaseAction {
     public:
         BackupSimulation();
+        BackupSimulation(const string &filePath);
         void act(Simulation &simulation) override;
         BackupSimulation *clone() const override;
-        const string toString() const override;
+        void print(OutputBuffer &out) const override;
+    protected:
+        void saveArguments(BinaryWriter &writer) const override;
     private:
+        const string filePath;
 };
 
 
 class RestoreSimulation : public BaseAction {
     public:
         RestoreSimulation();
+        RestoreSimulation(const string &filePath);
         void act(Simulation &simulation) override;
         RestoreSimulation *clone() const override;
-        const string toString() const override;
+        void print(OutputBuffer &out) const override;
+    protected:
+        void saveArguments(BinaryWriter &writer) const override;
     private:
+        const string filePath;
 };
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Action.h"
+#include "Binary.h"
+using std::vector;
+
+/*
+The list of actions the simulation has run, kept encoded rather than as objects:
+each action is its BaseAction::save() bytes (tag, varint arguments, status), with
+names and messages interned in a string table shared by every copy of the log.
+
+The bytes are kept in segments of about SEGMENT_BYTES. Only the last segment is ever
+written to; full segments never change, so copies of the log share them, and
+appending only copies the last segment when it is shared. Once the full segments
+held in memory pass MEMORY_BUDGET, the oldest ones are written to a temporary spill
+file and read back only when the log is walked.
+*/
+class ActionLog {
+    public:
+        ActionLog();
+
+        void append(BaseAction *action);
+        size_t size() const;
+        size_t getNumOfBytes() const;
+        void forEach(const std::function<void(const BaseAction&)> &visit) const;
+        void clear();
+
+    private:
+        static const size_t SEGMENT_BYTES = 64 * 1024;
+        static const size_t MEMORY_BUDGET = 64 * 1024 * 1024;
+
+        class SpillFile {
+            public:
+                SpillFile();
+                SpillFile(const SpillFile& other) = delete;
+                SpillFile& operator=(const SpillFile& other) = delete;
+                ~SpillFile();
+
+                long write(const vector<char> &bytes);
+                void read(long offset, vector<char> &bytes) const;
+
+            private:
+                std::FILE *file;
+                long size;
+        };
+
+        struct Segment {
+            Segment();
+            vector<char> bytes;
+            size_t length;
+            size_t count;
+            long spillOffset;
+            std::shared_ptr<SpillFile> spillFile;
+        };
+
+        void spillOldSegments();
+
+        vector<std::shared_ptr<Segment>> segments;
+        std::shared_ptr<StringTable> names;
+        std::shared_ptr<SpillFile> spillFile;
+        BinaryWriter encoder;
+        size_t count;
+        size_t numOfBytes;
+        size_t firstResident;
+};
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <unordered_map>
+using std::vector;
+
+/*
+Finds the facility that leaves a plan's scores most balanced. Adding a facility with
+scores (lq, eco, env) to a plan moves the plan's differences (lq - eco, lq - env) by
+the facility's own differences, and the balance distance is
+max(|lq - eco|, |lq - env|, |eco - env|) of the sum. So every facility is a point in
+the plane, and the best facility is the point nearest to the plan's negated
+differences under the norm max(|x|, |y|, |x - y|).
+
+Facilities with the same point are interchangeable, and the first one wins ties, so
+only the first facility at each point is kept. The points are bucketed in a square
+grid. A query visits the grid in square rings around the target. That norm is never
+below the Chebyshev distance, so once the best distance found is within the rings
+already visited, no unvisited point can beat it or tie with it.
+*/
+class BalanceIndex {
+    public:
+        BalanceIndex();
+
+        void add(int index, int lifeQualityScore, int economyScore, int environmentScore);
+        int findNearest(int lifeQualityScore, int economyScore, int environmentScore, int &distance) const;
+        bool empty() const;
+
+    private:
+        struct Point {
+            int x;
+            int y;
+            int index;
+        };
+
+        static long long key(int x, int y);
+        static int floorDivide(int value, int divisor);
+        void insert(int position);
+        void rebuild();
+        void visitCell(int cellX, int cellY, int targetX, int targetY, int &bestDistance, int &bestIndex) const;
+
+        vector<Point> points;
+        std::unordered_map<long long, int> pointIndex;
+        std::unordered_map<long long, vector<int>> cells;
+        int cellSize;
+        int minX, maxX, minY, maxY;
+        int minCellX, maxCellX, minCellY, maxCellY;
+        size_t builtSize;
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+using std::string;
+using std::vector;
+
+/*
+Strings that are written many times can be interned: each distinct string is kept
+once and written as its number in the table. Entries are never removed, so numbers
+stay valid for as long as the table lives.
+*/
+class StringTable {
+    public:
+        StringTable();
+
+        uint64_t intern(const string &value);
+        const string& get(uint64_t id) const;
+
+    private:
+        vector<string> strings;
+        std::unordered_map<string, uint64_t> ids;
+};
+
+/*
+Helpers for the binary snapshot image. Counts and small numbers are written as
+LEB128 varints (signed ones zigzag-encoded first), strings as a length followed by
+the bytes (or, with a string table set, as the string's number in the table), and
+large int arrays as raw little-endian blocks that are copied back in one go.
+*/
+class BinaryWriter {
+    public:
+        BinaryWriter();
+        BinaryWriter(const BinaryWriter& other) = default;
+        BinaryWriter& operator=(const BinaryWriter& other) = default;
+
+        void writeByte(uint8_t value);
+        void writeVarint(uint64_t value);
+        void writeSignedVarint(int64_t value);
+        void writeString(const string &value);
+        void writeInts(const int *values, size_t count);
+        void writeBytes(const char *bytes, size_t count);
+        const vector<char>& getBuffer() const;
+        void writeToFile(const string &filePath) const;
+        void setStringTable(StringTable *table);
+        void clear();
+
+    private:
+        vector<char> buffer;
+        StringTable *table;
+};
+
+/*
+Reads back what BinaryWriter wrote, from memory the reader does not own (usually a
+mapped file). Reading past the end throws std::runtime_error.
+*/
+class BinaryReader {
+    public:
+        BinaryReader(const char *begin, const char *end);
+
+        uint8_t readByte();
+        uint64_t readVarint();
+        int64_t readSignedVarint();
+        int readInt();
+        size_t readCount();
+        string readString();
+        void readInts(int *values, size_t count);
+        const char* readBytes(size_t count);
+        bool atEnd() const;
+        void setStringTable(const StringTable *table);
+
+    private:
+        void require(size_t count) const;
+
+        const char *cursor;
+        const char *end;
+        const StringTable *table;
+};
+
+/*
+A read-only memory mapping of a whole file, unmapped when the object goes away.
+*/
+class MappedFile {
+    public:
+        MappedFile(const string &filePath);
+        MappedFile(const MappedFile& other) = delete;
+        MappedFile& operator=(const MappedFile& other) = delete;
+        ~MappedFile();
+
+        const char* begin() const;
+        const char* end() const;
+
+    private:
+        const char *data;
+        size_t size;
+};
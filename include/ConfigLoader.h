@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+class Simulation;
+class ThreadPool;
+
+/*
+Reads a configuration file into a simulation. The file is mapped into memory and
+tokenized where it lies, so names are only copied once they end up in a settlement
+or a facility type. Large files are cut at line boundaries into chunks that are
+parsed on the pool; the parsed lines are then applied to the simulation in file
+order, so the result is the same as reading the file line by line.
+
+Lines that are blank, start with '#' or start with an unknown word are skipped.
+A malformed line, a name that is already taken, or a plan for a settlement that is
+not defined above it throws std::runtime_error naming the line number.
+*/
+class ConfigLoader {
+    public:
+        static void load(const string &configFilePath, Simulation &simulation, ThreadPool *pool);
+
+    private:
+        enum class LineType {
+            SETTLEMENT,
+            FACILITY,
+            PLAN,
+        };
+
+        // One parsed line. name points into the mapped file.
+        struct Line {
+            LineType type;
+            int lineNumber;
+            const char *name;
+            size_t nameLength;
+            int values[5];
+        };
+
+        struct Chunk {
+            Chunk(const char *begin, const char *end);
+            Chunk(const Chunk& other) = default;
+            Chunk& operator=(const Chunk& other) = default;
+            const char *begin;
+            const char *end;
+            vector<Line> lines;
+            int numOfLines;
+            int errorLine;
+            string error;
+        };
+
+        static void parseChunk(Chunk &chunk);
+        static bool parseLine(const char *cursor, const char *end, Line &line, string &error);
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include <vector>
+#include "Binary.h"
+#include "MemoryPool.h"
+using std::vector;
+
+/*
+The buildings a plan currently has under construction. Each one has a slot in the
+order it was started, which is the order they are listed in and the order they
+become operational within one step, and is due at a fixed tick of the queue's own
+clock. A min-heap on (due tick, slot) says which ones finish next, so a step costs
+O(log n) per building that completes, skipping steps costs nothing, and no step looks
+at the buildings that are still running, however high the plan's cap is.
+
+The slots of completed buildings are cleared and squeezed out only once they make up
+half of the slots (and at least MIN_EMPTY_SLOTS of them), so the listing order is
+kept without moving entries on every completion. A building with a build time of zero or less never finishes: it keeps
+that countdown and stays listed.
+*/
+class ConstructionQueue {
+    public:
+        ConstructionQueue();
+
+        int size() const;
+        bool empty() const;
+        void push(int typeIndex, int buildTime);
+        int step();
+        int nextCompletion() const;
+        void advance(long long steps);
+        void takeCompleted(PoolVector<int> &completedTypes);
+        void save(BinaryWriter &writer, long long stepsBehind) const;
+        void load(BinaryReader &reader);
+
+        // Calls visit(typeIndex, timeLeft) for every building, in the order they were started.
+        template <typename Visitor>
+        void forEach(Visitor visit) const;
+
+    private:
+        // due is the tick the building finishes at, or its countdown if that is zero or less.
+        struct Slot {
+            int typeIndex;
+            long long due;
+        };
+
+        struct Pending {
+            long long due;
+            int slot;
+        };
+
+        // Orders the heap so the earliest due building, lowest slot first, is on top.
+        struct IsLater {
+            bool operator()(const Pending &first, const Pending &second) const {
+                return first.due != second.due ? first.due > second.due : first.slot > second.slot;
+            }
+        };
+
+        static const int EMPTY = -1;
+        static const int MIN_EMPTY_SLOTS = 16;
+
+        int getTimeLeft(const Slot &slot) const;
+        void compact();
+
+        long long clock;
+        PoolVector<Slot> slots;
+        PoolVector<Pending> pending;
+        PoolVector<int> completedSlots;
+        // Scratch space for compact(), kept to save an allocation each time.
+        PoolVector<int> renumbered;
+        int numOfEmptySlots;
+};
+
+template <typename Visitor>
+void ConstructionQueue::forEach(Visitor visit) const {
+    for (const Slot &slot : slots) {
+        if (slot.typeIndex != EMPTY) {
+            visit(slot.typeIndex, getTimeLeft(slot));
+        }
+    }
+}
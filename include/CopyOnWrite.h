@@ -0,0 +1,37 @@
+#pragma once
+#include <memory>
+#include <utility>
+#include "MemoryPool.h"
+
+/*
+A value that copies of its owner share until one of them changes it. Copying is just
+a reference count increment. read() never copies, and write() first takes a private
+copy if anybody else still holds the same value. Values (and their reference counts)
+come from the memory pool of the open scope, if any.
+*/
+template <typename T>
+class CopyOnWrite {
+    public:
+        CopyOnWrite() : data(std::allocate_shared<T>(PoolAllocator<T>())) {}
+        explicit CopyOnWrite(T *value) : data(value) {}
+        // The value and its reference count in one allocation.
+        explicit CopyOnWrite(T &&value) : data(std::allocate_shared<T>(PoolAllocator<T>(), std::move(value))) {}
+
+        const T& read() const {
+            return *data;
+        }
+
+        T& write() {
+            if (data.use_count() > 1) {
+                data = std::allocate_shared<T>(PoolAllocator<T>(), *data);
+            }
+            return *data;
+        }
+
+        bool isShared() const {
+            return data.use_count() > 1;
+        }
+
+    private:
+        std::shared_ptr<T> data;
+};
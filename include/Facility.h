@@ -39,21 +39,25 @@ class FacilityType {
 
 
 
-class Facility: public FacilityType {
+/*
+A single building. Everything that is the same for every building of a kind (name,
+category, price, scores) stays in its FacilityType in the facility options, and the
+building keeps only the index of that entry and its own progress. The settlement is
+the one of the plan that owns the building.
+*/
+class Facility {
 
     public:
-        Facility(const string &name, const string &settlementName, const FacilityCategory category, const int price, const int lifeQuality_score, const int economy_score, const int environment_score);
-        Facility(const FacilityType &type, const string &settlementName);
+        Facility(int typeIndex, const FacilityType &type);
+        Facility(int typeIndex, FacilityStatus status, int timeLeft);
         Facility(const Facility& other);
-        const string &getSettlementName() const;
+        int getTypeIndex() const;
         int getTimeLeft() const;
-        FacilityStatus step();
-        void setStatus(FacilityStatus status);
         const FacilityStatus& getStatus() const;
-        const string toString() const;
+        const string toString(const FacilityType &type, const string &settlementName) const;
 
     private:
-        const string settlementName;
+        int typeIndex;
         FacilityStatus status;
         int timeLeft;
 };
\ No newline at end of file
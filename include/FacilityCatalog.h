@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "Facility.h"
+#include "BalanceIndex.h"
+using std::string;
+using std::vector;
+
+/*
+The facility options a plan can choose from. Entries are only ever appended, so an
+entry's index never changes. Next to the entries the catalog keeps an index from name
+to entry, used to refuse duplicate names, and the indices of each category's entries
+in catalog order, so a policy that only builds one category never has to look at the
+others, and a BalanceIndex over every entry's scores.
+*/
+class FacilityCatalog {
+    public:
+        FacilityCatalog();
+
+        bool add(const FacilityType &facility);
+        bool contains(const string &facilityName) const;
+        int size() const;
+        bool empty() const;
+        void reserve(size_t count);
+        const FacilityType& operator[](int index) const;
+        const vector<FacilityType>& getOptions() const;
+        const vector<int>& getCategory(FacilityCategory category) const;
+        int nextInCategory(FacilityCategory category, int lastIndex, int &position) const;
+        int nextInCategory(FacilityCategory category, int lastIndex, int &position, int count, vector<int> &selected) const;
+        int findMostBalancing(int lifeQualityScore, int economyScore, int environmentScore, int &distance) const;
+
+    private:
+        static const int NUM_OF_CATEGORIES = 3;
+
+        vector<FacilityType> options;
+        std::unordered_map<string, int> nameIndex;
+        vector<int> categories[NUM_OF_CATEGORIES];
+        BalanceIndex balance;
+};
+
+// Used on every selection, so defined here to be inlined.
+inline int FacilityCatalog::size() const {
+    return static_cast<int>(options.size());
+}
+
+inline const FacilityType& FacilityCatalog::operator[](int index) const {
+    return options[index];
+}
+
+inline const vector<int>& FacilityCatalog::getCategory(FacilityCategory category) const {
+    return categories[static_cast<int>(category)];
+}
@@ -0,0 +1,160 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+using std::vector;
+
+/*
+The memory of one simulation. Objects are carved out of large blocks and freed ones
+go onto a free list for their size, so creating and deleting them never reaches
+malloc/free. Every thread that uses the pool gets a shard of its own (the block it
+cuts from and free lists), so threads only wait on each other when one shows up for
+the first time or starts a new block.
+Memory freed on one thread is reused by that thread's shard; it all belongs to the
+pool either way.
+
+A simulation and the backups copied from it share one pool, since they share plans.
+When the last of them goes, release() turns every later free into nothing. The
+blocks are cut from address space the pool reserves a region at a time (pages are
+only backed once they are used), so the destructor gives them all back with one
+munmap per region, normally just one.
+Requests bigger than the largest size class fall through to the global operator new.
+*/
+class MemoryPool {
+    public:
+        /*
+        While a scope is open, everything this thread allocates through PoolAllocator
+        or a class-level operator new comes from the pool the scope points to. The
+        scope keeps a pointer to the simulation's own member, so it follows the
+        simulation when a restore or load puts a different pool there.
+        */
+        class Scope {
+            public:
+                explicit Scope(const std::shared_ptr<MemoryPool> *pool);
+                Scope(const Scope& other) = delete;
+                Scope& operator=(const Scope& other) = delete;
+                ~Scope();
+
+                // What the innermost open scope on this thread points to, or null.
+                static const std::shared_ptr<MemoryPool>* getActive();
+
+            private:
+                const std::shared_ptr<MemoryPool> *previous;
+        };
+
+        MemoryPool();
+        MemoryPool(const MemoryPool& other) = delete;
+        MemoryPool& operator=(const MemoryPool& other) = delete;
+        ~MemoryPool();
+
+        void* allocate(size_t size);
+        void deallocate(void* pointer, size_t size);
+        void release();
+
+        // The pool of the innermost open scope on this thread, or null.
+        static MemoryPool* current();
+        // For class-level operator new and delete: the owning pool is kept in front of the object.
+        static void* allocateObject(size_t size);
+        static void deallocateObject(void* pointer, size_t size);
+
+    private:
+        struct FreeNode {
+            FreeNode* next;
+        };
+
+        // Sizes up to 512 bytes come in steps of 16, then in four steps per doubling up to 8 KiB.
+        static const size_t GRANULE = 16;
+        static const size_t NUM_OF_SMALL_CLASSES = 32;
+        static const size_t STEPS_PER_DOUBLING = 4;
+        static const size_t NUM_OF_SIZE_CLASSES = NUM_OF_SMALL_CLASSES + 4 * STEPS_PER_DOUBLING;
+        static const size_t MAX_SIZE = 8 * 1024;
+        static const size_t BLOCK_SIZE = 64 * 1024;
+        static const size_t REGION_SIZE = static_cast<size_t>(16) << 30;
+        static const size_t HEADER_SIZE = 16;
+
+        struct Shard {
+            Shard();
+            Shard(const Shard& other) = delete;
+            Shard& operator=(const Shard& other) = delete;
+            std::thread::id owner;
+            char* blockCursor;
+            char* blockEnd;
+            FreeNode* freeLists[NUM_OF_SIZE_CLASSES];
+        };
+
+        static size_t getSizeClass(size_t size);
+        static size_t getClassSize(size_t sizeClass);
+        Shard& getShard();
+        Shard& addShard();
+        char* takeBlock();
+
+        // The shard this thread used last, and the id of the pool it belongs to.
+        static thread_local uint64_t cachedPoolId;
+        static thread_local Shard *cachedShard;
+
+        const uint64_t id;
+        // Guards the shards and the regions.
+        std::mutex shardsLock;
+        vector<Shard*> shards;
+        vector<std::pair<char*, size_t>> regions;
+        char* regionCursor;
+        char* regionEnd;
+        bool released;
+};
+
+/*
+A C++11 allocator over a MemoryPool, for the containers a plan owns. A default
+constructed one takes the pool of the scope that is open, so a plan's containers
+come from its simulation's pool without passing the pool along. Copies of a container
+stay in the pool of the one they were copied from.
+*/
+template <typename T>
+class PoolAllocator {
+    public:
+        typedef T value_type;
+        typedef std::true_type propagate_on_container_move_assignment;
+        typedef std::true_type propagate_on_container_swap;
+
+        PoolAllocator() : pool(MemoryPool::current()) {}
+        explicit PoolAllocator(MemoryPool *pool) : pool(pool) {}
+        template <typename U>
+        PoolAllocator(const PoolAllocator<U> &other) : pool(other.getPool()) {}
+
+        T* allocate(size_t count) {
+            const size_t size = count * sizeof(T);
+            return static_cast<T*>(pool != nullptr ? pool->allocate(size) : ::operator new(size));
+        }
+
+        void deallocate(T* pointer, size_t count) {
+            if (pool != nullptr) {
+                pool->deallocate(pointer, count * sizeof(T));
+            } else {
+                ::operator delete(pointer);
+            }
+        }
+
+        MemoryPool* getPool() const {
+            return pool;
+        }
+
+    private:
+        MemoryPool *pool;
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T> &first, const PoolAllocator<U> &second) {
+    return first.getPool() == second.getPool();
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T> &first, const PoolAllocator<U> &second) {
+    return first.getPool() != second.getPool();
+}
+
+template <typename T>
+using PoolVector = std::vector<T, PoolAllocator<T>>;
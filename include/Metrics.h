@@ -0,0 +1,179 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+using std::vector;
+
+/*
+Process-wide counters and latency histograms, always on. Every thread records into
+its own shard, so recording is a relaxed load and store on memory no other thread
+writes: no locks and no cache lines bouncing between the step workers. snapshot()
+adds the shards up.
+
+Latencies are kept in power-of-two buckets of nanoseconds. Plan::step runs millions
+of times per command, so every call is counted but only one in SAMPLE_INTERVAL per
+thread is timed, along with the batch of selections it makes to refill its slots.
+PLAN_STEPS also counts the steps that are skipped rather than stepped (quiet steps,
+repeated cycles and plans left behind by Simulation::advance), so it is every plan's
+share of the simulated steps.
+Every selection starts a facility, so FACILITIES_STARTED is also the number of
+selections. Work done on the side, like the optimize command's what-if branches, is
+kept out with a Pause.
+*/
+class Metrics {
+    public:
+        enum Counter {
+            PLAN_STEPS,
+            FACILITIES_STARTED,
+            FACILITIES_COMPLETED,
+            SIMULATED_STEPS,
+            NUM_OF_COUNTERS,
+        };
+
+        // One timer per action type, then the hot paths.
+        enum Timer {
+            ACTION_STEP,
+            ACTION_PLAN,
+            ACTION_SETTLEMENT,
+            ACTION_FACILITY,
+            ACTION_PLAN_STATUS,
+            ACTION_CHANGE_POLICY,
+            ACTION_LOG,
+            ACTION_CLOSE,
+            ACTION_BACKUP,
+            ACTION_RESTORE,
+            ACTION_STATS,
+            ACTION_OPTIMIZE,
+            ACTION_TOP,
+            ACTION_AGGREGATE,
+            SIMULATION_STEP,
+            PLAN_STEP,
+            SELECT_FACILITY,
+            NUM_OF_TIMERS,
+        };
+
+        // Values that are set rather than added up: what the last step command did.
+        enum Gauge {
+            LAST_STEP_STEPS,
+            LAST_STEP_STARTED,
+            LAST_STEP_COMPLETED,
+            NUM_OF_GAUGES,
+        };
+
+        class Pause;
+
+        static const int NUM_OF_BUCKETS = 64;
+        static const unsigned SAMPLE_INTERVAL = 64;
+        static const Timer FIRST_ACTION = ACTION_STEP;
+        static const Timer LAST_ACTION = ACTION_AGGREGATE;
+
+        struct Histogram {
+            Histogram();
+            uint64_t count;
+            uint64_t errors;
+            uint64_t totalNanoseconds;
+            uint64_t maxNanoseconds;
+            uint64_t buckets[NUM_OF_BUCKETS];
+
+            uint64_t percentile(double fraction) const;
+        };
+
+        struct Snapshot {
+            Snapshot();
+            uint64_t counters[NUM_OF_COUNTERS];
+            uint64_t gauges[NUM_OF_GAUGES];
+            Histogram timers[NUM_OF_TIMERS];
+        };
+
+        static const char* getTimerName(Timer timer);
+
+        static void add(Counter counter, uint64_t amount = 1);
+        static void set(Gauge gauge, uint64_t value);
+        static void record(Timer timer, uint64_t nanoseconds);
+        static void recordError(Timer timer);
+        static bool countPlanStep();
+        static uint64_t now();
+        static Snapshot snapshot();
+
+    private:
+        friend struct ShardRegistry;
+
+        struct Shard {
+            Shard();
+            Shard(const Shard& other) = delete;
+            Shard& operator=(const Shard& other) = delete;
+
+            // Keeps the next shard's first counters off this shard's last cache line.
+            char padding[64];
+            std::atomic<uint64_t> counters[NUM_OF_COUNTERS];
+            std::atomic<uint64_t> counts[NUM_OF_TIMERS];
+            std::atomic<uint64_t> errors[NUM_OF_TIMERS];
+            std::atomic<uint64_t> totals[NUM_OF_TIMERS];
+            std::atomic<uint64_t> maxima[NUM_OF_TIMERS];
+            std::atomic<uint64_t> buckets[NUM_OF_TIMERS][NUM_OF_BUCKETS];
+        };
+
+        static Shard*& current();
+        static Shard& shard();
+        static Shard* registerThread();
+        static void bump(std::atomic<uint64_t> &value, uint64_t amount);
+
+        static std::atomic<uint64_t> gauges[NUM_OF_GAUGES];
+};
+
+/*
+While a pause is open, this thread records into a shard of its own that snapshot()
+never reads, so the calls cost the same and count for nothing. Threads a paused
+task is handed to need their own pause.
+*/
+class Metrics::Pause {
+    public:
+        Pause();
+        Pause(const Pause& other) = delete;
+        Pause& operator=(const Pause& other) = delete;
+        ~Pause();
+
+    private:
+        Shard *previous;
+};
+
+/*
+A function-local pointer with a constant initializer: every translation unit reads it
+straight from thread-local storage, without the wrapper call a thread_local declared
+in one file and defined in another needs.
+*/
+inline Metrics::Shard*& Metrics::current() {
+    static thread_local Shard *shard = nullptr;
+    return shard;
+}
+
+inline Metrics::Shard& Metrics::shard() {
+    Shard *mine = current();
+    if (mine == nullptr) {
+        mine = registerThread();
+    }
+    return *mine;
+}
+
+// Only the owning thread writes a shard, so this needs no read-modify-write instruction.
+inline void Metrics::bump(std::atomic<uint64_t> &value, uint64_t amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+inline void Metrics::add(Counter counter, uint64_t amount) {
+    bump(shard().counters[counter], amount);
+}
+
+// Counts a Plan::step and tells whether this one should be timed.
+inline bool Metrics::countPlanStep() {
+    std::atomic<uint64_t>& steps = shard().counters[PLAN_STEPS];
+    uint64_t count = steps.load(std::memory_order_relaxed);
+    steps.store(count + 1, std::memory_order_relaxed);
+    return count % SAMPLE_INTERVAL == 0;
+}
+
+inline uint64_t Metrics::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
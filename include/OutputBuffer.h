@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+/*
+Text output gathered in a fixed block and handed to the stream in large writes.
+The block is allocated once and reused: when the next piece doesn't fit, what is
+gathered so far is written out first. Integers are formatted into the block
+directly, two digits at a time, without going through the stream or a string.
+*/
+class OutputBuffer {
+    public:
+        static const size_t DEFAULT_CAPACITY = 1 << 16;
+
+        OutputBuffer(std::ostream &sink, size_t capacity = DEFAULT_CAPACITY);
+        OutputBuffer(const OutputBuffer& other) = delete;
+        OutputBuffer& operator=(const OutputBuffer& other) = delete;
+
+        void append(const char *text, size_t count);
+        void append(const char *text);
+        void append(const string &text);
+        void append(char c);
+        void appendInt(long long value);
+        void flush();
+
+    private:
+        std::ostream &sink;
+        vector<char> block;
+        size_t length;
+};
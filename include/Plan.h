@@ -1,9 +1,15 @@
 #pragma once
 #include <vector>
 #include <algorithm>
+#include <memory>
+#include <functional>
 #include "Facility.h"
 #include "Settlement.h"
+#include "FacilityCatalog.h"
 #include "SelectionPolicy.h"
+#include "ConstructionQueue.h"
+#include "CopyOnWrite.h"
+#include "MemoryPool.h"
 using std::vector;
 
 enum class PlanStatus {
@@ -13,39 +19,61 @@ enum class PlanStatus {
 
 class Plan {
     public:
-        Plan(const int planId, const Settlement &settlement, SelectionPolicy *selectionPolicy, const vector<FacilityType> &facilityOptions);
+        Plan(const int planId, const std::shared_ptr<const Settlement> &settlement, SelectionPolicy *selectionPolicy);
         Plan(const Plan& other);
         Plan& operator=(const Plan& other) = delete;
-        Plan(const Plan&& other) = delete;
-        Plan& operator=(const Plan&& other) = delete;
+        Plan(Plan&& other) noexcept;
+        Plan& operator=(Plan&& other) noexcept;
         ~Plan();
         
         int getlifeQualityScore() const;
         int getEconomyScore() const;
         int getEnvironmentScore() const;
         void setSelectionPolicy(SelectionPolicy *selectionPolicy);
-        void step();
-        void printStatus();
-        const vector<Facility*> &getFacilities() const;
-        const vector<Facility*> &getUnderConstruction() const;
-        void addFacility(Facility* facility);
-        const string toString() const;
-        const string getSettlementName() const;
-        bool isAvailable ();
-        const string getSelectionPolicyString() const;
+        void step(const FacilityCatalog &facilityOptions);
+        int stepsToNextEvent(const FacilityCatalog &facilityOptions) const;
+        void skip(long long steps);
+        void advance(const FacilityCatalog &facilityOptions, int numOfSteps);
+        const PoolVector<Facility> &getFacilities() const;
+        const ConstructionQueue &getUnderConstruction() const;
+        void addFacility(const Facility &facility, const FacilityType &type);
+        void dropFacilities();
+        const string toString(const FacilityCatalog &facilityOptions) const;
+        const string &getSettlementName() const;
+        SettlementType getSettlementType() const;
+        bool isAvailable () const;
+        const char* getSelectionPolicyName() const;
         int getPlanId() const;
+        int getConstructionCap() const;
         SelectionPolicy* getSelectionPolicy() const;
+        void save(BinaryWriter &writer, long long stepsBehind) const;
+        static Plan load(BinaryReader &reader, int numOfFacilityOptions,
+                         const std::function<std::shared_ptr<const Settlement>(const string&)> &findSettlement);
 
 
     private:
+        // The step loop, compiled once per built-in policy class and once for SelectionPolicy.
+        template <typename Policy>
+        void step(Policy &policy, const FacilityCatalog &facilityOptions);
+        template <typename Policy>
+        int stepsToNextEvent(const Policy &policy, const FacilityCatalog &facilityOptions) const;
+        template <typename Policy>
+        void advance(Policy &policy, const FacilityCatalog &facilityOptions, int numOfSteps);
+        template <typename Policy>
+        void repeatCycle(Policy &policy, const FacilityCatalog &facilityOptions, size_t firstFacility, int lifeQualityGain, int economyGain, int environmentGain, int times);
+
+        const string cycleKey() const;
 
         int plan_id;
-        const Settlement &settlement;
+        std::shared_ptr<const Settlement> settlement;
         int construction_cap;
         SelectionPolicy *selectionPolicy; //What happens if we change this to a reference?
         PlanStatus status;
-        vector<Facility*> facilities;
-        vector<Facility*> underConstruction;
-        const vector<FacilityType> &facilityOptions;
+        CopyOnWrite<PoolVector<Facility>> facilities;
+        bool listsFacilities;
+        size_t numOfFacilities;
+        ConstructionQueue underConstruction;
+        PoolVector<int> completedTypes;
+        vector<int> selectedTypes;
         int life_quality_score, economy_score, environment_score;
 };
\ No newline at end of file
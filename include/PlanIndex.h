@@ -0,0 +1,112 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "CopyOnWrite.h"
+#include "Plan.h"
+#include "SegmentedVector.h"
+#include "SegmentedSet.h"
+using std::string;
+using std::vector;
+
+/*
+Leaderboards and per-group totals of the plans' scores, for the top and aggregate
+commands. Every metric has an ordered set of (score, plan), so the best k plans are
+its last k entries, and every grouping keeps a running count and total per group.
+Plans are identified by their position in the simulation, which is their plan ID.
+
+Plans are stepped on many threads at once, so they don't update the index
+themselves. Each worker notes the scores of the plans it changed before and after,
+and the simulation applies all of them when the step is done: one sorted merge per
+metric, plus O(1) per change for the totals. New plans and plans changed through
+Simulation::getPlan are marked and read before the next step or query, again with
+one merge per metric, so loading many plans doesn't insert them one by one. A query
+costs O(k) or O(groups), whatever the number of plans.
+
+Copies share everything, like the plans themselves: the sets and the entries are
+kept in copy-on-write pieces, so after a backup a change copies the pieces it
+touches rather than the whole index.
+*/
+class PlanIndex {
+    public:
+        enum Metric {
+            LIFE_QUALITY,
+            ECONOMY,
+            ENVIRONMENT,
+            NUM_OF_METRICS,
+        };
+
+        enum Grouping {
+            BY_SETTLEMENT,
+            BY_TYPE,
+            BY_POLICY,
+            NUM_OF_GROUPINGS,
+        };
+
+        struct Group {
+            Group(const string &name, int numOfPlans, long long total);
+            string name;
+            int numOfPlans;
+            long long total;
+        };
+
+        // One plan's scores before and after a step.
+        struct Change {
+            int planId;
+            int before[NUM_OF_METRICS];
+            int after[NUM_OF_METRICS];
+        };
+
+        PlanIndex();
+
+        static bool parseMetric(const string &name, Metric &metric);
+        static bool parseGrouping(const string &name, Grouping &grouping);
+        static const char* getScoreName(Metric metric);
+        static int getScore(const Plan &plan, Metric metric);
+
+        void addPlan(const Plan &plan);
+        void markChanged(int planId);
+        void refresh(const SegmentedVector<CopyOnWrite<Plan>> &plans);
+        void apply(const vector<Change> &changes);
+        vector<int> top(Metric metric, int count) const;
+        vector<Group> aggregate(Metric metric, Grouping grouping) const;
+
+    private:
+        // What the sets and totals currently hold for one plan.
+        struct Entry {
+            int scores[NUM_OF_METRICS];
+            int groups[NUM_OF_GROUPINGS];
+            bool changed;
+            // Whether the sets and totals hold the plan yet; a new plan joins them on the next refresh.
+            bool listed;
+        };
+
+        struct Totals {
+            Totals();
+            int numOfPlans;
+            long long totals[NUM_OF_METRICS];
+        };
+
+        // The names of the settlement and policy groups, which only grow.
+        struct Names {
+            Names();
+            vector<string> settlementNames;
+            std::unordered_map<string, int> settlementGroups;
+            vector<string> policyNames;
+            std::unordered_map<string, int> policyGroups;
+        };
+
+        // (score, -plan ID): the last entry is the highest score, lowest plan ID first.
+        typedef std::pair<int, int> Key;
+
+        void read(Entry &entry, const Plan &plan);
+        int policyGroup(const SelectionPolicy &policy);
+        void count(const Entry &entry, int sign);
+
+        SegmentedVector<Entry> entries;
+        vector<int> changedPlans;
+        SegmentedSet<Key> boards[NUM_OF_METRICS];
+        CopyOnWrite<vector<Totals>> totals[NUM_OF_GROUPINGS];
+        CopyOnWrite<Names> names;
+};
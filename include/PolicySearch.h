@@ -0,0 +1,84 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Plan.h"
+#include "FacilityCatalog.h"
+using std::string;
+using std::vector;
+
+class ThreadPool;
+
+/*
+Looks for the policy schedule that does best for one plan over the next horizon
+steps. The horizon is cut into at most MAX_SEGMENTS segments of equal length (the
+last one may be shorter) and every assignment of the four policies to the segments
+is simulated, switching policy at segment starts the way changePolicy would:
+choosing the policy the plan already has keeps it as it is. Among schedules that
+score the same on the objective, the one with the higher total score wins, then the
+one with the fewest switches.
+
+The schedules form a tree, so each shared prefix is simulated once and every branch
+is a copy of its parent plan. The search works on a copy that has dropped its list of
+built facilities (see Plan::dropFacilities), so a branch is just its scores, policy
+and buildings in progress, however long the horizon. The top of the tree is cut into
+subtrees that are searched on the pool, each depth-first, so only one path of copies
+per task is alive at a time. Remaining ties go to the schedule that comes first
+(policies in nve, bal, eco, env order), so the answer does not depend on the number
+of threads. The branches' steps are not recorded in the Metrics.
+*/
+class PolicySearch {
+    public:
+        enum class Objective {
+            LIFE_QUALITY,
+            ECONOMY,
+            ENVIRONMENT,
+            MIN_SCORE,
+            BALANCE,
+        };
+
+        struct Result {
+            Result();
+            vector<int> schedule;
+            int segmentLength;
+            int numOfSchedules;
+            int lifeQualityScore;
+            int economyScore;
+            int environmentScore;
+        };
+
+        static const int NUM_OF_POLICIES = 4;
+        static const int MAX_SEGMENTS = 6;
+
+        static bool parseObjective(const string &name, Objective &objective);
+        static const char* getPolicyName(int policy);
+        static Result search(const Plan &plan, const FacilityCatalog &facilityOptions, int horizon,
+                             Objective objective, ThreadPool *pool);
+
+    private:
+        struct Candidate {
+            Candidate();
+            bool found;
+            long long primary;
+            long long secondary;
+            int switches;
+            int schedule;
+            int lifeQualityScore;
+            int economyScore;
+            int environmentScore;
+
+            bool isBetterThan(const Candidate &other) const;
+        };
+
+        PolicySearch(const FacilityCatalog &facilityOptions, int horizon, Objective objective);
+
+        int segmentSteps(int segment) const;
+        bool advanceBranch(Plan &branch, int segment, int policy) const;
+        void explore(const Plan &node, int segment, int schedule, int switches, Candidate &best) const;
+        Candidate evaluate(const Plan &leaf, int schedule, int switches) const;
+
+        const FacilityCatalog &facilityOptions;
+        const int horizon;
+        const Objective objective;
+        int numOfSegments;
+        int segmentLength;
+};
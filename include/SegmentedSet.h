@@ -0,0 +1,129 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "CopyOnWrite.h"
+using std::vector;
+
+/*
+A sorted set of keys kept in chunks of up to 2 * CHUNK_SIZE keys, each a sorted
+vector, and changed in sorted batches. Like SegmentedVector, copies share their
+chunks and a chunk is copied only when one of the copies changes it, so after a
+backup a batch copies the chunks it touches and the list of chunks, not every key.
+*/
+template <typename T, size_t CHUNK_SIZE = 512>
+class SegmentedSet {
+    public:
+        SegmentedSet() : chunks(), count(0) {}
+
+        size_t size() const {
+            return count;
+        }
+
+        /*
+        Takes out the keys in removed and puts in the keys in added, both sorted, in one
+        pass over the chunks; a key in both stays. Chunks that neither list touches are
+        kept (and stay shared), and each touched one is merged with its keys, so a batch
+        costs O(number of chunks + touched chunks * CHUNK_SIZE + changes).
+        */
+        void update(const vector<T> &removed, const vector<T> &added) {
+            if (removed.empty() && added.empty()) {
+                return;
+            }
+            if (chunks.empty()) {
+                Chunk keys(added);
+                vector<CopyOnWrite<Chunk>> rebuilt;
+                store(rebuilt, keys);
+                chunks.swap(rebuilt);
+                count = added.size();
+                return;
+            }
+
+            vector<CopyOnWrite<Chunk>> rebuilt;
+            rebuilt.reserve(chunks.size() + 1);
+            size_t nextRemoved = 0;
+            size_t nextAdded = 0;
+            for (size_t i = 0; i < chunks.size(); i++) {
+                // Everything below the next chunk's first key belongs to this chunk.
+                size_t removedEnd = removed.size();
+                size_t addedEnd = added.size();
+                if (i + 1 < chunks.size()) {
+                    const T& upper = chunks[i + 1].read().front();
+                    removedEnd = std::lower_bound(removed.begin() + nextRemoved, removed.end(), upper) - removed.begin();
+                    addedEnd = std::lower_bound(added.begin() + nextAdded, added.end(), upper) - added.begin();
+                }
+                if (removedEnd == nextRemoved && addedEnd == nextAdded) {
+                    rebuilt.push_back(std::move(chunks[i]));
+                    continue;
+                }
+
+                const Chunk& chunk = chunks[i].read();
+                Chunk merged;
+                merged.reserve(chunk.size() + (addedEnd - nextAdded));
+                size_t next = 0;
+                while (next < chunk.size() || nextAdded < addedEnd) {
+                    if (nextAdded < addedEnd && (next == chunk.size() || added[nextAdded] < chunk[next])) {
+                        merged.push_back(added[nextAdded++]);
+                        continue;
+                    }
+                    while (nextRemoved < removedEnd && removed[nextRemoved] < chunk[next]) {
+                        nextRemoved++;
+                    }
+                    if (nextRemoved < removedEnd && !(chunk[next] < removed[nextRemoved])) {
+                        nextRemoved++;
+                    } else {
+                        merged.push_back(chunk[next]);
+                    }
+                    next++;
+                }
+                count = count - chunk.size() + merged.size();
+                nextRemoved = removedEnd;
+                store(rebuilt, merged);
+            }
+            chunks.swap(rebuilt);
+        }
+
+        // The count largest keys, largest first.
+        vector<T> last(size_t count) const {
+            vector<T> keys;
+            for (size_t i = chunks.size(); i > 0 && keys.size() < count; i--) {
+                const Chunk& chunk = chunks[i - 1].read();
+                for (size_t j = chunk.size(); j > 0 && keys.size() < count; j--) {
+                    keys.push_back(chunk[j - 1]);
+                }
+            }
+            return keys;
+        }
+
+    private:
+        typedef vector<T> Chunk;
+
+        /*
+        Appends sorted keys that go after everything in chunks. A small remainder joins
+        the chunk before it when there is room, and a long run is cut into chunks of
+        CHUNK_SIZE, so chunks stay between a few and 2 * CHUNK_SIZE keys.
+        */
+        static void store(vector<CopyOnWrite<Chunk>> &chunks, Chunk &keys) {
+            if (keys.empty()) {
+                return;
+            }
+            if (keys.size() < CHUNK_SIZE / 4 && !chunks.empty() && chunks.back().read().size() + keys.size() <= 2 * CHUNK_SIZE) {
+                Chunk& previous = chunks.back().write();
+                previous.insert(previous.end(), keys.begin(), keys.end());
+                return;
+            }
+            if (keys.size() <= 2 * CHUNK_SIZE) {
+                chunks.push_back(CopyOnWrite<Chunk>(std::move(keys)));
+                return;
+            }
+            const size_t numOfPieces = (keys.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+            for (size_t piece = 0; piece < numOfPieces; piece++) {
+                chunks.push_back(CopyOnWrite<Chunk>(Chunk(keys.begin() + keys.size() * piece / numOfPieces,
+                                                          keys.begin() + keys.size() * (piece + 1) / numOfPieces)));
+            }
+        }
+
+        vector<CopyOnWrite<Chunk>> chunks;
+        size_t count;
+};
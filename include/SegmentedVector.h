@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "CopyOnWrite.h"
+using std::vector;
+
+/*
+A vector kept in segments of SEGMENT_SIZE elements. A segment's storage is reserved
+in full when it is started, so adding an element never moves the ones before it:
+growth is O(1) and references to elements stay valid. Copies share their segments,
+and a segment is copied only when one of the copies changes it, so after a backup
+adding an element or changing one copies a single segment, not the whole vector.
+*/
+template <typename T, size_t SEGMENT_SIZE = 1024>
+class SegmentedVector {
+    public:
+        SegmentedVector() : segments(), count(0) {}
+
+        size_t size() const {
+            return count;
+        }
+
+        const T& operator[](size_t index) const {
+            return segments[index / SEGMENT_SIZE].read()[index % SEGMENT_SIZE];
+        }
+
+        T& write(size_t index) {
+            return segments[index / SEGMENT_SIZE].write()[index % SEGMENT_SIZE];
+        }
+
+        template <typename... Args>
+        T& emplace_back(Args&&... args) {
+            if (count % SEGMENT_SIZE == 0) {
+                segments.emplace_back();
+            }
+            vector<T>& segment = segments.back().write();
+            // A segment copied from a shared one only has room for what it holds.
+            if (segment.capacity() < SEGMENT_SIZE) {
+                segment.reserve(SEGMENT_SIZE);
+            }
+            segment.emplace_back(std::forward<Args>(args)...);
+            count++;
+            return segment.back();
+        }
+
+        /*
+        Takes a private copy of every shared segment. Afterwards write() doesn't copy
+        anything until this vector is copied again, so threads may call it at the same
+        time for different elements.
+        */
+        void unshare() {
+            for (CopyOnWrite<vector<T>>& segment : segments) {
+                segment.write();
+            }
+        }
+
+        void clear() {
+            segments.clear();
+            count = 0;
+        }
+
+    private:
+        vector<CopyOnWrite<vector<T>>> segments;
+        size_t count;
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "Binary.h"
+#include "FacilityCatalog.h"
+#include "MemoryPool.h"
+using std::string;
+using std::vector;
+
+/*
+The facilities a policy has selected, in order, as catalog indices. The history only
+grows, so it is kept in fixed-size segments that copies share, like ActionLog: a
+cloned policy copies one pointer per segment, and appending copies only the last
+segment, and only when it is shared. The text listing is built on request.
+*/
+class SelectionHistory {
+    public:
+        SelectionHistory();
+
+        void append(int typeIndex);
+        void append(const int *typeIndices, int numOfSelections);
+        int size() const;
+        int get(int index) const;
+        const string toString(const FacilityCatalog &facilitiesOptions) const;
+        void save(BinaryWriter &writer) const;
+        void load(BinaryReader &reader, int numOfFacilityOptions);
+
+    private:
+        static const int SEGMENT_SIZE = 1024;
+        typedef PoolVector<int> Segment;
+
+        PoolVector<std::shared_ptr<Segment>> segments;
+        int count;
+};
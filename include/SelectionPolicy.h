@@ -1,75 +1,283 @@
 #pragma once
+#include <cstdint>
+#include <stdexcept>
+#include <string>
 #include <vector>
 #include "Facility.h"
+#include "FacilityCatalog.h"
+#include "SelectionHistory.h"
+#include "Binary.h"
+using std::string;
 using std::vector;
 
+/*
+What a policy is, read in O(1) from the policy itself. The built-in kinds double as
+the policies' snapshot tags and as their numbers in the registry. Any other policy is
+CUSTOM and is only known by its name.
+*/
+enum class PolicyKind : uint8_t {
+    NAIVE,
+    BALANCED,
+    ECONOMY,
+    SUSTAINABILITY,
+    CUSTOM,
+};
+
+/*
+Policies are created by name through a registry that starts with the four built-in
+ones (nve, bal, eco, env), so plan lines, plan and changePolicy all accept whatever is
+registered. A custom policy derives from SelectionPolicy with PolicyKind::CUSTOM, is
+registered with a Factory before the simulation starts (lookups take no lock), and
+starts its save() with saveKind(). Built-in policies are final and Plan steps them
+through their own classes, so their selection is compiled into the step loop; a
+custom one goes through the virtual functions.
+*/
 class SelectionPolicy {
     public:
-        virtual const FacilityType& selectFacility(const vector<FacilityType>& facilitiesOptions) = 0;
-        virtual const string toString() const = 0;
+        /*
+        create gets the plan's current scores, which a balanced policy starts from; a
+        new plan's are all 0. load reads what save() wrote after saveKind(), and may be
+        null for a policy that can't be restored from a snapshot.
+        */
+        struct Factory {
+            SelectionPolicy* (*create)(int lifeQualityScore, int economyScore, int environmentScore);
+            SelectionPolicy* (*load)(BinaryReader &reader, int numOfFacilityOptions);
+        };
+
+        explicit SelectionPolicy(PolicyKind kind);
+        PolicyKind getKind() const;
+        virtual const char* getName() const = 0;
+        virtual const FacilityType& selectFacility(const FacilityCatalog& facilitiesOptions) = 0;
+        virtual void selectFacilities(const FacilityCatalog& facilitiesOptions, int count, vector<int> &selected);
+        virtual const string toString(const FacilityCatalog& facilitiesOptions) const = 0;
         virtual SelectionPolicy* clone() const = 0;
+        virtual bool canSelect(const FacilityCatalog& facilitiesOptions) const;
+        virtual bool isPeriodic() const;
+        virtual int getCursor() const;
+        virtual void save(BinaryWriter &writer) const = 0;
+        static SelectionPolicy* load(BinaryReader &reader, int numOfFacilityOptions);
         virtual ~SelectionPolicy() = default;
+        static void* operator new(size_t size);
+        static void operator delete(void* pointer, size_t size);
+
+        static int registerPolicy(const string &name, const Factory &factory);
+        static int findPolicy(const string &name);
+        static int getNumOfPolicies();
+        static const char* getPolicyName(int policy);
+        static SelectionPolicy* create(int policy, int lifeQualityScore, int economyScore, int environmentScore);
+
+    protected:
+        void saveKind(BinaryWriter &writer) const;
+
+    private:
+        PolicyKind kind;
 };
 
-class NaiveSelection: public SelectionPolicy {
+class NaiveSelection final: public SelectionPolicy {
     public:
         NaiveSelection();
-        const FacilityType& selectFacility(const vector<FacilityType>& facilitiesOptions) override;
-        const string toString() const override;
+        const char* getName() const override;
+        const FacilityType& selectFacility(const FacilityCatalog& facilitiesOptions) override;
+        void selectFacilities(const FacilityCatalog& facilitiesOptions, int count, vector<int> &selected) override;
+        const string toString(const FacilityCatalog& facilitiesOptions) const override;
         NaiveSelection *clone() const override;
+        bool isPeriodic() const override;
+        int getCursor() const override;
+        void save(BinaryWriter &writer) const override;
+        static NaiveSelection* load(BinaryReader &reader, int numOfFacilityOptions);
         ~NaiveSelection() override = default;
     private:
         int lastSelectedIndex;
         int numberOfFacilities;
-        string builtFacilitiesList;
+        SelectionHistory builtFacilities;
 };
 
-class BalancedSelection: public SelectionPolicy {
+class BalancedSelection final: public SelectionPolicy {
     public:
         BalancedSelection(int LifeQualityScore, int EconomyScore, int EnvironmentScore);
-        const FacilityType& selectFacility(const vector<FacilityType>& facilitiesOptions) override;
-        const string toString() const override;
+        const char* getName() const override;
+        const FacilityType& selectFacility(const FacilityCatalog& facilitiesOptions) override;
+        void selectFacilities(const FacilityCatalog& facilitiesOptions, int count, vector<int> &selected) override;
+        const string toString(const FacilityCatalog& facilitiesOptions) const override;
         BalancedSelection *clone() const override;
+        void save(BinaryWriter &writer) const override;
+        static BalancedSelection* load(BinaryReader &reader);
         ~BalancedSelection() override = default;
     private:
         int LifeQualityScore;
         int EconomyScore;
         int EnvironmentScore;
         int numberOfFacilities;
-        string builtFacilitiesList;
 
 };
 
-class EconomySelection: public SelectionPolicy {
+class EconomySelection final: public SelectionPolicy {
     public:
         EconomySelection();
-        const FacilityType& selectFacility(const vector<FacilityType>& facilitiesOptions) override;
-        const string toString() const override;
+        const char* getName() const override;
+        const FacilityType& selectFacility(const FacilityCatalog& facilitiesOptions) override;
+        void selectFacilities(const FacilityCatalog& facilitiesOptions, int count, vector<int> &selected) override;
+        const string toString(const FacilityCatalog& facilitiesOptions) const override;
         EconomySelection *clone() const override;
+        bool canSelect(const FacilityCatalog& facilitiesOptions) const override;
+        bool isPeriodic() const override;
+        int getCursor() const override;
+        void save(BinaryWriter &writer) const override;
+        static EconomySelection* load(BinaryReader &reader, int numOfFacilityOptions);
         ~EconomySelection() override = default;
     private:
         int lastSelectedIndex;
+        int lastSelectedPosition;
         int numberOfFacilities;
-        string builtFacilitiesList;
+        SelectionHistory builtFacilities;
 
 
 
 };
 
-class SustainabilitySelection: public SelectionPolicy {
+class SustainabilitySelection final: public SelectionPolicy {
     public:
         SustainabilitySelection();
-        const FacilityType& selectFacility(const vector<FacilityType>& facilitiesOptions) override;
-        const string toString() const override;
+        const char* getName() const override;
+        const FacilityType& selectFacility(const FacilityCatalog& facilitiesOptions) override;
+        void selectFacilities(const FacilityCatalog& facilitiesOptions, int count, vector<int> &selected) override;
+        const string toString(const FacilityCatalog& facilitiesOptions) const override;
         SustainabilitySelection *clone() const override;
+        bool canSelect(const FacilityCatalog& facilitiesOptions) const override;
+        bool isPeriodic() const override;
+        int getCursor() const override;
+        void save(BinaryWriter &writer) const override;
+        static SustainabilitySelection* load(BinaryReader &reader, int numOfFacilityOptions);
         ~SustainabilitySelection() override = default;
     private:
         int lastSelectedIndex;
+        int lastSelectedPosition;
         int numberOfFacilities;
-        string builtFacilitiesList;
+        SelectionHistory builtFacilities;
         
     
 
 };
 
 
+/*
+The selections are defined here rather than in SelectionPolicy.cpp so that Plan's step
+loop, which is compiled once per built-in policy, can inline them. Each batch makes
+the same selections as that many selectFacility() calls in a single pass.
+*/
+inline const FacilityType& NaiveSelection::selectFacility(const FacilityCatalog& facilitiesOptions){
+    numberOfFacilities++;
+    lastSelectedIndex = lastSelectedIndex + 1 < facilitiesOptions.size() ? lastSelectedIndex + 1 : 0;
+    builtFacilities.append(lastSelectedIndex);
+    return facilitiesOptions[lastSelectedIndex];
+}
+
+inline void NaiveSelection::selectFacilities(const FacilityCatalog& facilitiesOptions, int count, vector<int> &selected){
+    if (count <= 0) {
+        return;
+    }
+    const size_t first = selected.size();
+    const int size = facilitiesOptions.size();
+    for (int i = 0; i < count; i++) {
+        lastSelectedIndex = lastSelectedIndex + 1 < size ? lastSelectedIndex + 1 : 0;
+        selected.push_back(lastSelectedIndex);
+    }
+    numberOfFacilities += count;
+    builtFacilities.append(&selected[first], count);
+}
+
+inline const FacilityType& BalancedSelection::selectFacility(const FacilityCatalog& facilitiesOptions){
+    numberOfFacilities++;
+
+    int minimalDistance;
+    const FacilityType& current = facilitiesOptions[facilitiesOptions.findMostBalancing(LifeQualityScore, EconomyScore, EnvironmentScore, minimalDistance)];
+
+    if (minimalDistance == 0){
+        return current;
+    }
+
+    LifeQualityScore += current.getLifeQualityScore();
+    EnvironmentScore += current.getEnvironmentScore();
+    EconomyScore += current.getEconomyScore();
+
+    return current;
+}
+
+// Once the closest facility leaves the scores unchanged, every later selection is that facility too.
+inline void BalancedSelection::selectFacilities(const FacilityCatalog& facilitiesOptions, int count, vector<int> &selected){
+    if (count <= 0) {
+        return;
+    }
+    numberOfFacilities += count;
+    for (int i = 0; i < count; i++) {
+        int minimalDistance;
+        const int index = facilitiesOptions.findMostBalancing(LifeQualityScore, EconomyScore, EnvironmentScore, minimalDistance);
+        if (minimalDistance == 0) {
+            selected.insert(selected.end(), count - i, index);
+            break;
+        }
+        const FacilityType& current = facilitiesOptions[index];
+        LifeQualityScore += current.getLifeQualityScore();
+        EnvironmentScore += current.getEnvironmentScore();
+        EconomyScore += current.getEconomyScore();
+        selected.push_back(index);
+    }
+}
+
+inline bool EconomySelection::canSelect(const FacilityCatalog& facilitiesOptions) const{
+    return !facilitiesOptions.getCategory(FacilityCategory::ECONOMY).empty();
+}
+
+inline const FacilityType& EconomySelection::selectFacility(const FacilityCatalog& facilitiesOptions){
+    if(!canSelect(facilitiesOptions)){
+        throw std::runtime_error("No economy facility to select");
+    }
+
+    numberOfFacilities++;
+    lastSelectedIndex = facilitiesOptions.nextInCategory(FacilityCategory::ECONOMY, lastSelectedIndex, lastSelectedPosition);
+    builtFacilities.append(lastSelectedIndex);
+    return facilitiesOptions[lastSelectedIndex];
+}
+
+inline void EconomySelection::selectFacilities(const FacilityCatalog& facilitiesOptions, int count, vector<int> &selected){
+    if (count <= 0) {
+        return;
+    }
+    if(!canSelect(facilitiesOptions)){
+        throw std::runtime_error("No economy facility to select");
+    }
+
+    const size_t first = selected.size();
+    numberOfFacilities += count;
+    lastSelectedIndex = facilitiesOptions.nextInCategory(FacilityCategory::ECONOMY, lastSelectedIndex, lastSelectedPosition, count, selected);
+    builtFacilities.append(&selected[first], count);
+}
+
+inline bool SustainabilitySelection::canSelect(const FacilityCatalog& facilitiesOptions) const{
+    return !facilitiesOptions.getCategory(FacilityCategory::ENVIRONMENT).empty();
+}
+
+inline const FacilityType& SustainabilitySelection::selectFacility(const FacilityCatalog& facilitiesOptions){
+    if(!canSelect(facilitiesOptions)){
+        throw std::runtime_error("No environment facility to select");
+    }
+
+    numberOfFacilities++;
+    lastSelectedIndex = facilitiesOptions.nextInCategory(FacilityCategory::ENVIRONMENT, lastSelectedIndex, lastSelectedPosition);
+    builtFacilities.append(lastSelectedIndex);
+    return facilitiesOptions[lastSelectedIndex];
+}
+
+inline void SustainabilitySelection::selectFacilities(const FacilityCatalog& facilitiesOptions, int count, vector<int> &selected){
+    if (count <= 0) {
+        return;
+    }
+    if(!canSelect(facilitiesOptions)){
+        throw std::runtime_error("No environment facility to select");
+    }
+
+    const size_t first = selected.size();
+    numberOfFacilities += count;
+    lastSelectedIndex = facilitiesOptions.nextInCategory(FacilityCategory::ENVIRONMENT, lastSelectedIndex, lastSelectedPosition, count, selected);
+    builtFacilities.append(&selected[first], count);
+}
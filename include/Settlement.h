@@ -1,6 +1,7 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <cstddef>
 using std::string;
 using std::vector;
 
@@ -15,16 +16,25 @@ enum class SettlementType {
 class Settlement {
     public:
         Settlement(const string &name, SettlementType type);
+        Settlement(const string &name, SettlementType type, int constructionCap);
         Settlement(const Settlement& other);
         
         const string &getName() const;
         SettlementType getType() const;
+        int getConstructionCap() const;
+        static int getDefaultConstructionCap(SettlementType type);
+        // The largest cap a configuration file or snapshot may give.
+        static const int MAX_CONSTRUCTION_CAP = 1 << 20;
         const string toString() const;
         const string settlementTypeToString(SettlementType type) const;
+        static void* operator new(size_t size);
+        static void operator delete(void* pointer, size_t size);
 
         private:
             const string name;
             SettlementType type;
+            // How many buildings a plan for this settlement can have in progress at once.
+            int constructionCap;
     
 };
 
@@ -1,11 +1,21 @@
 #pragma once
+#include <iostream>
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include "Facility.h"
+#include "FacilityCatalog.h"
 #include "Plan.h"
 #include "Settlement.h"
 #include "SelectionPolicy.h"
 #include "Action.h"
+#include "ThreadPool.h"
+#include "ActionLog.h"
+#include "CopyOnWrite.h"
+#include "SegmentedVector.h"
+#include "Metrics.h"
+#include "PlanIndex.h"
+#include "MemoryPool.h"
 using std::string;
 using std::vector;
 
@@ -14,34 +24,63 @@ class SelectionPolicy;
 
 class Simulation {
     public:
-        Simulation(const string &configFilePath);
+        Simulation(const string &configFilePath, int numOfThreads = 1);
         Simulation(const Simulation& other);
         Simulation& operator=(const Simulation& other);
         Simulation(Simulation&& other);
         Simulation& operator=(Simulation&& other);
         ~Simulation();
         
-        void start();
+        void start(std::istream &input = std::cin, bool showPrompts = true);
         void addPlan(const Settlement &settlement, SelectionPolicy *selectionPolicy);
         void addAction(BaseAction *action);
         bool addSettlement(Settlement *settlement);
         bool addFacility(FacilityType facility);
-        bool isSettlementExists(const string &settlementName);
-        Settlement &getSettlement(const string &settlementName);
+        bool isSettlementExists(const string &settlementName) const;
+        const Settlement &getSettlement(const string &settlementName) const;
+        bool isFacilityExists(const string &facilityName) const;
         Plan &getPlan(const int planID);
+        const Plan &viewPlan(const int planID) const;
+        Plan copyPlan(const int planID) const;
         void step();
+        void advance(int numOfSteps);
+        void setNumOfThreads(int numOfThreads);
+        int getNumOfThreads() const;
+        ThreadPool* getThreadPool();
         void close();
-        void open();
-        const vector<BaseAction*>& getActionsLog() const;
-        bool isPlanExists(const int planID);
-        const std::vector<Plan>& getPlans() const;
-
+        const ActionLog& getActionsLog() const;
+        bool isPlanExists(const int planID) const;
+        int getNumOfPlans() const;
+        const FacilityCatalog& getFacilitiesOptions() const;
+        const PlanIndex& getPlanIndex();
+        void saveSnapshot(const string &filePath) const;
+        void loadSnapshot(const string &filePath);
 
     private:
+        void runOnPlans(const std::function<void(size_t, size_t)> &work);
+        void run(BaseAction *action, Metrics::Timer timer);
+        std::shared_ptr<MemoryPool> replacePool(const std::shared_ptr<MemoryPool> &pool);
+        Plan& catchUp(int planID);
+        std::shared_ptr<const Settlement> findSettlement(const string &settlementName) const;
+        std::shared_ptr<const Settlement> shareSettlement(const Settlement &settlement) const;
+
+        // Shared with copies, and declared first so it outlives everything allocated from it.
+        std::shared_ptr<MemoryPool> memoryPool;
         bool isRunning;
         int planCounter; 
-        vector<BaseAction*> actionsLog;
-        vector<Plan> plans;
-        vector<Settlement*> settlements;
-        vector<FacilityType> facilitiesOptions;
+        ActionLog actionsLog;
+        // Plans never move once added, and are shared with backups one by one.
+        SegmentedVector<CopyOnWrite<Plan>> plans;
+        // Steps simulated so far, and the step each plan has been brought up to: a plan
+        // with nothing due is left behind, still shared, until it is next stepped or changed.
+        long long currentStep;
+        SegmentedVector<long long> planSteps;
+        CopyOnWrite<vector<std::shared_ptr<const Settlement>>> settlements;
+        CopyOnWrite<FacilityCatalog> facilitiesOptions;
+        // Name -> position in settlements, shared and copied along with them.
+        CopyOnWrite<std::unordered_map<string, int>> settlementIndex;
+        // Leaderboards and totals over plans, shared with copies piece by piece like the plans.
+        PlanIndex planIndex;
+        int numOfThreads;
+        ThreadPool* stepPool;
 };
\ No newline at end of file
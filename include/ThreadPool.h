@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <exception>
+#include "MemoryPool.h"
+using std::vector;
+
+/*
+A fixed-size work-stealing pool. Every worker owns a deque of tasks: it pops
+from the back of its own deque and, once that is empty, steals from the front
+of the other workers' deques, so uneven tasks even out on their own.
+The thread that calls run() works as worker 0 and returns once every task is done.
+Tasks allocate from the memory pool the caller has open (see MemoryPool::Scope).
+If tasks throw, the rest still run and run() rethrows the first exception.
+*/
+class ThreadPool {
+    public:
+        ThreadPool(int numOfThreads);
+        ThreadPool(const ThreadPool& other) = delete;
+        ThreadPool& operator=(const ThreadPool& other) = delete;
+        ~ThreadPool();
+
+        int getNumOfThreads() const;
+        void run(vector<std::function<void()>> &tasks);
+
+    private:
+        struct WorkQueue {
+            WorkQueue();
+            std::mutex lock;
+            std::deque<std::function<void()>*> tasks;
+        };
+
+        void workerLoop(int workerId);
+        void drain(int workerId);
+        bool popTask(int workerId, std::function<void()>* &task);
+
+        const int numOfThreads;
+        vector<WorkQueue*> queues;
+        vector<std::thread> workers;
+        std::mutex stateLock;
+        std::condition_variable wakeup;
+        std::condition_variable done;
+        std::atomic<int> pending;
+        const std::shared_ptr<MemoryPool> *taskPool;
+        int generation;
+        std::exception_ptr error;
+        bool stopping;
+};
@@ -2,9 +2,25 @@
 #include <iostream>
 #include <string>
 #include "Simulation.h"
+#include "PolicySearch.h"
+#include <sstream>
+#include <stdexcept>
 using std::string;
 using namespace std;
 
+/*
+Everything the actions print goes through this one buffer, so printing a large state
+reuses the same block instead of building a string for every line.
+*/
+static OutputBuffer& output() {
+    static OutputBuffer buffer(std::cout);
+    return buffer;
+}
+
+static const char* statusName(ActionStatus status) {
+    return status == ActionStatus::COMPLETED ? "COMPLETED" : "ERROR";
+}
+
 BaseAction::BaseAction() : errorMsg(""), status(ActionStatus::ERROR) {}
 
 ActionStatus BaseAction::getStatus() const {
@@ -18,30 +34,148 @@ void BaseAction::complete() {
 void BaseAction::error(string errorMsg) {
     status = ActionStatus::ERROR;
     this->errorMsg = errorMsg;
-    std::cout << "Error: " << errorMsg << std::endl;
+    OutputBuffer& out = output();
+    out.append("Error: ");
+    out.append(errorMsg);
+    out.append('\n');
+    out.flush();
+}
+
+const string BaseAction::toString() const {
+    std::ostringstream text;
+    OutputBuffer out(text, 256);
+    print(out);
+    out.flush();
+    return text.str();
 }
 
 const string& BaseAction::getErrorMsg() const {
     return errorMsg;
 }
 
+enum ActionTag : uint8_t {
+    SIMULATE_STEP_TAG,
+    ADD_PLAN_TAG,
+    ADD_SETTLEMENT_TAG,
+    ADD_FACILITY_TAG,
+    PRINT_PLAN_STATUS_TAG,
+    CHANGE_PLAN_POLICY_TAG,
+    PRINT_ACTIONS_LOG_TAG,
+    CLOSE_TAG,
+    BACKUP_SIMULATION_TAG,
+    RESTORE_SIMULATION_TAG,
+    PRINT_STATS_TAG,
+    OPTIMIZE_PLAN_TAG,
+    TOP_PLANS_TAG,
+    AGGREGATE_PLANS_TAG,
+};
+
+/*
+An action is saved as its tag and constructor arguments (saveArguments), then how it
+ended: its status and, for errors, the message.
+*/
+void BaseAction::save(BinaryWriter &writer) const {
+    saveArguments(writer);
+    writer.writeByte(static_cast<uint8_t>(status));
+    if (status == ActionStatus::ERROR) {
+        writer.writeString(errorMsg);
+    }
+}
+
+BaseAction* BaseAction::load(BinaryReader &reader) {
+    BaseAction* action = nullptr;
+    uint8_t tag = reader.readByte();
+
+    if (tag == SIMULATE_STEP_TAG) {
+        action = new SimulateStep(reader.readInt());
+    } else if (tag == ADD_PLAN_TAG) {
+        string settlementName = reader.readString();
+        string selectionPolicy = reader.readString();
+        action = new AddPlan(settlementName, selectionPolicy);
+    } else if (tag == ADD_SETTLEMENT_TAG) {
+        string settlementName = reader.readString();
+        int settlementType = reader.readInt();
+        action = new AddSettlement(settlementName, static_cast<SettlementType>(settlementType));
+    } else if (tag == ADD_FACILITY_TAG) {
+        string facilityName = reader.readString();
+        int category = reader.readInt();
+        int price = reader.readInt();
+        int lifeQualityScore = reader.readInt();
+        int economyScore = reader.readInt();
+        int environmentScore = reader.readInt();
+        action = new AddFacility(facilityName, static_cast<FacilityCategory>(category), price, lifeQualityScore, economyScore, environmentScore);
+    } else if (tag == PRINT_PLAN_STATUS_TAG) {
+        action = new PrintPlanStatus(reader.readInt());
+    } else if (tag == CHANGE_PLAN_POLICY_TAG) {
+        int planId = reader.readInt();
+        string newPolicy = reader.readString();
+        action = new ChangePlanPolicy(planId, newPolicy);
+    } else if (tag == PRINT_ACTIONS_LOG_TAG) {
+        action = new PrintActionsLog();
+    } else if (tag == CLOSE_TAG) {
+        action = new Close();
+    } else if (tag == BACKUP_SIMULATION_TAG) {
+        action = new BackupSimulation(reader.readString());
+    } else if (tag == RESTORE_SIMULATION_TAG) {
+        action = new RestoreSimulation(reader.readString());
+    } else if (tag == PRINT_STATS_TAG) {
+        action = new PrintStats(reader.readString());
+    } else if (tag == OPTIMIZE_PLAN_TAG) {
+        int planId = reader.readInt();
+        int horizon = reader.readInt();
+        string objective = reader.readString();
+        action = new OptimizePlan(planId, horizon, objective);
+    } else if (tag == TOP_PLANS_TAG) {
+        string metric = reader.readString();
+        int count = reader.readInt();
+        action = new TopPlans(metric, count);
+    } else if (tag == AGGREGATE_PLANS_TAG) {
+        string metric = reader.readString();
+        string grouping = reader.readString();
+        action = new AggregatePlans(metric, grouping);
+    } else {
+        throw std::runtime_error("Unknown action in snapshot");
+    }
+
+    try {
+        uint8_t status = reader.readByte();
+        if (status == static_cast<uint8_t>(ActionStatus::COMPLETED)) {
+            action->status = ActionStatus::COMPLETED;
+        } else {
+            action->status = ActionStatus::ERROR;
+            action->errorMsg = reader.readString();
+        }
+    }
+    catch (...) {
+        delete action;
+        throw;
+    }
+    return action;
+}
+
 SimulateStep::SimulateStep(const int numOfSteps) : numOfSteps(numOfSteps) {}
 
 void SimulateStep::act(Simulation &simulation) {
-    for(int i = 0; i < numOfSteps; i++) {
-        simulation.step();
-    }
+    simulation.advance(numOfSteps);
     complete();
 }
 
-const string SimulateStep::toString() const {
-    return "step " + std::to_string(numOfSteps) + " " + (getStatus() == ActionStatus::COMPLETED ? "COMPLETED" : "ERROR");
+void SimulateStep::print(OutputBuffer &out) const {
+    out.append("step ");
+    out.appendInt(numOfSteps);
+    out.append(' ');
+    out.append(statusName(getStatus()));
 }
 
 SimulateStep* SimulateStep::clone() const {
     return new SimulateStep(*this);
 }
 
+void SimulateStep::saveArguments(BinaryWriter &writer) const {
+    writer.writeByte(SIMULATE_STEP_TAG);
+    writer.writeSignedVarint(numOfSteps);
+}
+
 AddPlan::AddPlan(const string &settlementName, const string &selectionPolicy)
     : settlementName(settlementName), selectionPolicy(selectionPolicy) {}
 
@@ -51,34 +185,36 @@ void AddPlan::act(Simulation &simulation) {
         return;
     }
 
-    SelectionPolicy* policy = nullptr;
-    if(selectionPolicy == "nve") {
-        policy = new NaiveSelection();
-    } else if(selectionPolicy == "bal") {
-        policy = new BalancedSelection(0,0,0);
-    } else if(selectionPolicy == "eco") {
-        policy = new EconomySelection();
-    } else if(selectionPolicy == "env") {
-        policy = new SustainabilitySelection();
-    } else {
+    int policy = SelectionPolicy::findPolicy(selectionPolicy);
+    if (policy == -1) {
         error("Cannot create this plan");
         return;
     }
 
-    Settlement& settlement = simulation.getSettlement(settlementName);
-    simulation.addPlan(settlement, policy);
+    const Settlement& settlement = simulation.getSettlement(settlementName);
+    simulation.addPlan(settlement, SelectionPolicy::create(policy, 0, 0, 0));
     complete();
 }
 
-const string AddPlan::toString() const {
-    return "plan " + settlementName + " " + selectionPolicy + " " + 
-           (getStatus() == ActionStatus::COMPLETED ? "COMPLETED" : "ERROR");
+void AddPlan::print(OutputBuffer &out) const {
+    out.append("plan ");
+    out.append(settlementName);
+    out.append(' ');
+    out.append(selectionPolicy);
+    out.append(' ');
+    out.append(statusName(getStatus()));
 }
 
 AddPlan* AddPlan::clone() const {
     return new AddPlan(*this);
 }
 
+void AddPlan::saveArguments(BinaryWriter &writer) const {
+    writer.writeByte(ADD_PLAN_TAG);
+    writer.writeString(settlementName);
+    writer.writeString(selectionPolicy);
+}
+
 AddSettlement::AddSettlement(const string &settlementName, SettlementType settlementType)
     : settlementName(settlementName), settlementType(settlementType) {}
 
@@ -97,15 +233,25 @@ void AddSettlement::act(Simulation &simulation) {
     }
 }
 
-const string AddSettlement::toString() const {
-    return "settlement " + settlementName + " " + std::to_string(static_cast<int>(settlementType)) + " " +
-           (getStatus() == ActionStatus::COMPLETED ? "COMPLETED" : "ERROR");
+void AddSettlement::print(OutputBuffer &out) const {
+    out.append("settlement ");
+    out.append(settlementName);
+    out.append(' ');
+    out.appendInt(static_cast<int>(settlementType));
+    out.append(' ');
+    out.append(statusName(getStatus()));
 }
 
 AddSettlement* AddSettlement::clone() const {
     return new AddSettlement(*this);
 }
 
+void AddSettlement::saveArguments(BinaryWriter &writer) const {
+    writer.writeByte(ADD_SETTLEMENT_TAG);
+    writer.writeString(settlementName);
+    writer.writeSignedVarint(static_cast<int>(settlementType));
+}
+
 AddFacility::AddFacility(const string &facilityName, const FacilityCategory facilityCategory, const int price,
                          const int lifeQualityScore, const int economyScore, const int environmentScore)
             : facilityName(facilityName), facilityCategory(facilityCategory), price(price),
@@ -121,111 +267,158 @@ void AddFacility::act(Simulation &simulation) {
     }
 }
 
-const string AddFacility::toString() const {
-    return "facility " + facilityName + " " + std::to_string(static_cast<int>(facilityCategory)) + " " +
-           std::to_string(price) + " " + std::to_string(lifeQualityScore) + " " +
-           std::to_string(economyScore) + " " + std::to_string(environmentScore) + " " +
-           (getStatus() == ActionStatus::COMPLETED ? "COMPLETED" : "ERROR");
+void AddFacility::print(OutputBuffer &out) const {
+    out.append("facility ");
+    out.append(facilityName);
+    out.append(' ');
+    out.appendInt(static_cast<int>(facilityCategory));
+    out.append(' ');
+    out.appendInt(price);
+    out.append(' ');
+    out.appendInt(lifeQualityScore);
+    out.append(' ');
+    out.appendInt(economyScore);
+    out.append(' ');
+    out.appendInt(environmentScore);
+    out.append(' ');
+    out.append(statusName(getStatus()));
 }
 
 AddFacility* AddFacility::clone() const {
     return new AddFacility(*this);
 }
 
+void AddFacility::saveArguments(BinaryWriter &writer) const {
+    writer.writeByte(ADD_FACILITY_TAG);
+    writer.writeString(facilityName);
+    writer.writeSignedVarint(static_cast<int>(facilityCategory));
+    writer.writeSignedVarint(price);
+    writer.writeSignedVarint(lifeQualityScore);
+    writer.writeSignedVarint(economyScore);
+    writer.writeSignedVarint(environmentScore);
+}
+
 PrintPlanStatus::PrintPlanStatus(int planId) : planId(planId) {}
 
 void PrintPlanStatus::act(Simulation &simulation) {
     if (simulation.isPlanExists(planId)) {
-        Plan& plan = simulation.getPlan(planId);
+        const Plan& plan = simulation.viewPlan(planId);
+        const FacilityCatalog& facilitiesOptions = simulation.getFacilitiesOptions();
+        OutputBuffer& out = output();
         
-        std::cout << "PlanID: " << planId << std::endl;
-        std::cout << "SettlementName: " << plan.getSettlementName() << std::endl;
-        std::cout << "PlanStatus: " << (plan.isAvailable() ? "AVAILABLE" : "BUSY") << std::endl;
-        std::cout << "SelectionPolicy: " << plan.getSelectionPolicyString() << std::endl;
+        out.append("PlanID: ");
+        out.appendInt(planId);
+        out.append("\nSettlementName: ");
+        out.append(plan.getSettlementName());
+        out.append(plan.isAvailable() ? "\nPlanStatus: AVAILABLE\n" : "\nPlanStatus: BUSY\n");
+        out.append("SelectionPolicy: ");
+        out.append(plan.getSelectionPolicyName());
         
-        std::cout << "LifeQualityScore: " << plan.getlifeQualityScore() << std::endl;
-        std::cout << "EconomyScore: " << plan.getEconomyScore() << std::endl;
-        std::cout << "EnvrionmentScore: " << plan.getEnvironmentScore() << std::endl;
-
-        const std::vector<Facility*>& underConstruction = plan.getUnderConstruction();
-        for (const Facility* facility : underConstruction) {
-            std::cout << "FacilityName: " << facility->getName() << std::endl;
-            std::cout << "FacilityStatus: UNDER_CONSTRUCTION" << std::endl; 
-        }
-
-        const std::vector<Facility*>& facilities = plan.getFacilities();
-        for (const Facility* facility : facilities) {
-            std::cout << "FacilityName: " << facility->getName() << std::endl;
-            std::cout << "FacilityStatus: OPERATIONAL" << std::endl; 
+        out.append("\nLifeQualityScore: ");
+        out.appendInt(plan.getlifeQualityScore());
+        out.append("\nEconomyScore: ");
+        out.appendInt(plan.getEconomyScore());
+        out.append("\nEnvrionmentScore: ");
+        out.appendInt(plan.getEnvironmentScore());
+        out.append('\n');
+
+        const ConstructionQueue& underConstruction = plan.getUnderConstruction();
+        underConstruction.forEach([&out, &facilitiesOptions](int typeIndex, int) {
+            out.append("FacilityName: ");
+            out.append(facilitiesOptions[typeIndex].getName());
+            out.append("\nFacilityStatus: UNDER_CONSTRUCTION\n");
+        });
+
+        const PoolVector<Facility>& facilities = plan.getFacilities();
+        for (const Facility& facility : facilities) {
+            out.append("FacilityName: ");
+            out.append(facilitiesOptions[facility.getTypeIndex()].getName());
+            out.append("\nFacilityStatus: OPERATIONAL\n");
         }
         
+        out.flush();
         complete();
     } else {
         error("Plan doesn't exist");
     }
 }
 
-const string PrintPlanStatus::toString() const {
-    return "planStatus " + std::to_string(planId) + " " +
-           (getStatus() == ActionStatus::COMPLETED ? "COMPLETED" : "ERROR");
+void PrintPlanStatus::print(OutputBuffer &out) const {
+    out.append("planStatus ");
+    out.appendInt(planId);
+    out.append(' ');
+    out.append(statusName(getStatus()));
 }
 
 PrintPlanStatus* PrintPlanStatus::clone() const {
     return new PrintPlanStatus(*this);
 }
 
+void PrintPlanStatus::saveArguments(BinaryWriter &writer) const {
+    writer.writeByte(PRINT_PLAN_STATUS_TAG);
+    writer.writeSignedVarint(planId);
+}
+
 ChangePlanPolicy::ChangePlanPolicy(const int planId, const string &newPolicy)
     : planId(planId), newPolicy(newPolicy) {}
 
 void ChangePlanPolicy::act(Simulation &simulation) {
     
-    Plan& plan = simulation.getPlan(planId);
+    if (!simulation.isPlanExists(planId)) {
+        error("Cannot change selection policy");
+        return;
+    }
 
-    if (!simulation.isPlanExists(planId) || plan.getSelectionPolicyString() == newPolicy) {
+    int policy = SelectionPolicy::findPolicy(newPolicy);
+    if (policy == -1) {
         error("Cannot change selection policy");
         return;
     }
 
-    SelectionPolicy* policy = nullptr;
-    
-    if(newPolicy == "nve") {
-        policy = new NaiveSelection();
-    } else if(newPolicy == "bal") {
-        policy = new BalancedSelection(plan.getlifeQualityScore(),plan.getEconomyScore(),plan.getEnvironmentScore());
-    } else if(newPolicy == "eco") {
-        policy = new EconomySelection();
-    } else if(newPolicy == "env") {
-        policy = new SustainabilitySelection();
-    } else {
+    Plan& plan = simulation.getPlan(planId);
+    if (plan.getSelectionPolicyName() == newPolicy) {
         error("Cannot change selection policy");
         return;
     }
 
-    plan.setSelectionPolicy(policy);
+    plan.setSelectionPolicy(SelectionPolicy::create(policy, plan.getlifeQualityScore(), plan.getEconomyScore(), plan.getEnvironmentScore()));
     complete();
 }
 
-const string ChangePlanPolicy::toString() const {
-    return "changePolicy " + std::to_string(planId) + " " + newPolicy + " " +
-           (getStatus() == ActionStatus::COMPLETED ? "COMPLETED" : "ERROR");
+void ChangePlanPolicy::print(OutputBuffer &out) const {
+    out.append("changePolicy ");
+    out.appendInt(planId);
+    out.append(' ');
+    out.append(newPolicy);
+    out.append(' ');
+    out.append(statusName(getStatus()));
 }
 
 ChangePlanPolicy* ChangePlanPolicy::clone() const {
     return new ChangePlanPolicy(*this);
 }
 
+void ChangePlanPolicy::saveArguments(BinaryWriter &writer) const {
+    writer.writeByte(CHANGE_PLAN_POLICY_TAG);
+    writer.writeSignedVarint(planId);
+    writer.writeString(newPolicy);
+}
+
 PrintActionsLog::PrintActionsLog() {}
 
 void PrintActionsLog::act(Simulation &simulation) {
-    for(const BaseAction* action : simulation.getActionsLog()) {
-        std::cout << action->toString() << std::endl;
-    }
+    OutputBuffer& out = output();
+    simulation.getActionsLog().forEach([&out](const BaseAction& action) {
+        action.print(out);
+        out.append('\n');
+    });
+    out.flush();
     complete();
 }
 
-const string PrintActionsLog::toString() const {
-    string status = (getStatus() == ActionStatus::COMPLETED) ? "COMPLETED" : "ERROR";
-    return "log " + status;
+void PrintActionsLog::print(OutputBuffer &out) const {
+    out.append("log ");
+    out.append(statusName(getStatus()));
 }
 
 
@@ -233,37 +426,418 @@ PrintActionsLog* PrintActionsLog::clone() const {
     return new PrintActionsLog(*this);
 }
 
+void PrintActionsLog::saveArguments(BinaryWriter &writer) const {
+    writer.writeByte(PRINT_ACTIONS_LOG_TAG);
+}
+
 Close::Close() {}
 
 void Close::act(Simulation &simulation) {
-    const std::vector<Plan>& plans = simulation.getPlans();
-    
-    for (int counter=0;counter<(static_cast<int>(plans.size()));counter++) {
-        Plan& plan = simulation.getPlan(counter);
-        std::cout << "PlanID: " << counter << std::endl;
-        std::cout << "SettlementName: " << plan.getSettlementName() << std::endl;
-        std::cout << "LifeQuality_Score: " << plan.getlifeQualityScore() << std::endl;
-        std::cout << "Economy_Score: " << plan.getEconomyScore() << std::endl;
-        std::cout << "Environment_Score: " << plan.getEnvironmentScore() << std::endl;
-        std::cout << std::endl;  
+    OutputBuffer& out = output();
+    for (int counter=0;counter<simulation.getNumOfPlans();counter++) {
+        const Plan& plan = simulation.viewPlan(counter);
+        out.append("PlanID: ");
+        out.appendInt(counter);
+        out.append("\nSettlementName: ");
+        out.append(plan.getSettlementName());
+        out.append("\nLifeQuality_Score: ");
+        out.appendInt(plan.getlifeQualityScore());
+        out.append("\nEconomy_Score: ");
+        out.appendInt(plan.getEconomyScore());
+        out.append("\nEnvironment_Score: ");
+        out.appendInt(plan.getEnvironmentScore());
+        out.append("\n\n");
     }
+    out.flush();
     
     simulation.close();
     complete();
 }
 
-const string Close::toString() const {
-    string status = (getStatus() == ActionStatus::COMPLETED) ? "COMPLETED" : "ERROR";
-    return "close " + status;
+void Close::print(OutputBuffer &out) const {
+    out.append("close ");
+    out.append(statusName(getStatus()));
 }
 
 Close* Close::clone() const {
     return new Close(*this);
 }
 
-BackupSimulation::BackupSimulation() {}
+void Close::saveArguments(BinaryWriter &writer) const {
+    writer.writeByte(CLOSE_TAG);
+}
+
+PrintStats::PrintStats(const string &format) : format(format) {}
+
+static void printLatency(OutputBuffer &out, const Metrics::Histogram &histogram) {
+    out.append("mean ");
+    out.appendInt(histogram.count == 0 ? 0 : histogram.totalNanoseconds / histogram.count);
+    out.append(" ns, p50 ");
+    out.appendInt(histogram.percentile(0.5));
+    out.append(" ns, p99 ");
+    out.appendInt(histogram.percentile(0.99));
+    out.append(" ns, max ");
+    out.appendInt(histogram.maxNanoseconds);
+    out.append(" ns\n");
+}
+
+static void printJsonLatency(OutputBuffer &out, const Metrics::Histogram &histogram) {
+    out.append("\"mean_ns\":");
+    out.appendInt(histogram.count == 0 ? 0 : histogram.totalNanoseconds / histogram.count);
+    out.append(",\"p50_ns\":");
+    out.appendInt(histogram.percentile(0.5));
+    out.append(",\"p99_ns\":");
+    out.appendInt(histogram.percentile(0.99));
+    out.append(",\"max_ns\":");
+    out.appendInt(histogram.maxNanoseconds);
+    out.append('}');
+}
+
+static void printJsonCounter(OutputBuffer &out, const char *name, uint64_t value) {
+    out.append('"');
+    out.append(name);
+    out.append("\":");
+    out.appendInt(value);
+    out.append(',');
+}
+
+/*
+Latencies are bucketed by powers of two, so a percentile is the top of its bucket
+(capped at the largest value seen) and can be up to twice the real value.
+*/
+void PrintStats::act(Simulation &simulation) {
+    const Metrics::Snapshot stats = Metrics::snapshot();
+    int available = 0;
+    for (int i = 0; i < simulation.getNumOfPlans(); i++) {
+        if (simulation.viewPlan(i).isAvailable()) {
+            available++;
+        }
+    }
+    const int busy = simulation.getNumOfPlans() - available;
+    const ActionLog& log = simulation.getActionsLog();
+    const Metrics::Histogram& simulationStep = stats.timers[Metrics::SIMULATION_STEP];
+    const Metrics::Histogram& planStep = stats.timers[Metrics::PLAN_STEP];
+    const Metrics::Histogram& selectFacility = stats.timers[Metrics::SELECT_FACILITY];
+    OutputBuffer& out = output();
+
+    if (format == "json") {
+        out.append("{\"actions\":{");
+        for (int timer = Metrics::FIRST_ACTION; timer <= Metrics::LAST_ACTION; timer++) {
+            const Metrics::Histogram& histogram = stats.timers[timer];
+            out.append(timer == Metrics::FIRST_ACTION ? "\"" : ",\"");
+            out.append(Metrics::getTimerName(static_cast<Metrics::Timer>(timer)));
+            out.append("\":{");
+            printJsonCounter(out, "count", histogram.count);
+            printJsonCounter(out, "errors", histogram.errors);
+            printJsonLatency(out, histogram);
+        }
+        out.append("},\"simulation_step\":{");
+        printJsonCounter(out, "count", simulationStep.count);
+        printJsonCounter(out, "steps", stats.counters[Metrics::SIMULATED_STEPS]);
+        printJsonLatency(out, simulationStep);
+        out.append(",\"plan_step\":{");
+        printJsonCounter(out, "count", stats.counters[Metrics::PLAN_STEPS]);
+        printJsonCounter(out, "timed", planStep.count);
+        printJsonLatency(out, planStep);
+        out.append(",\"select_facility\":{");
+        printJsonCounter(out, "count", stats.counters[Metrics::FACILITIES_STARTED]);
+        printJsonCounter(out, "timed", selectFacility.count);
+        printJsonLatency(out, selectFacility);
+        out.append(",\"facilities\":{\"started\":");
+        out.appendInt(stats.counters[Metrics::FACILITIES_STARTED]);
+        out.append(",\"completed\":");
+        out.appendInt(stats.counters[Metrics::FACILITIES_COMPLETED]);
+        out.append("},\"last_step\":{\"steps\":");
+        out.appendInt(stats.gauges[Metrics::LAST_STEP_STEPS]);
+        out.append(",\"started\":");
+        out.appendInt(stats.gauges[Metrics::LAST_STEP_STARTED]);
+        out.append(",\"completed\":");
+        out.appendInt(stats.gauges[Metrics::LAST_STEP_COMPLETED]);
+        out.append("},\"plans\":{\"available\":");
+        out.appendInt(available);
+        out.append(",\"busy\":");
+        out.appendInt(busy);
+        out.append("},\"log\":{\"actions\":");
+        out.appendInt(log.size());
+        out.append(",\"bytes\":");
+        out.appendInt(log.getNumOfBytes());
+        out.append("}}\n");
+    } else {
+        out.append("Actions:\n");
+        for (int timer = Metrics::FIRST_ACTION; timer <= Metrics::LAST_ACTION; timer++) {
+            const Metrics::Histogram& histogram = stats.timers[timer];
+            if (histogram.count == 0) {
+                continue;
+            }
+            out.append("  ");
+            out.append(Metrics::getTimerName(static_cast<Metrics::Timer>(timer)));
+            out.append(": ");
+            out.appendInt(histogram.count);
+            out.append(" run, ");
+            out.appendInt(histogram.errors);
+            out.append(" failed, ");
+            printLatency(out, histogram);
+        }
+        out.append("Simulation::step: ");
+        out.appendInt(simulationStep.count);
+        out.append(" calls, ");
+        out.appendInt(stats.counters[Metrics::SIMULATED_STEPS]);
+        out.append(" steps, ");
+        printLatency(out, simulationStep);
+        out.append("Plan::step: ");
+        out.appendInt(stats.counters[Metrics::PLAN_STEPS]);
+        out.append(" steps, ");
+        out.appendInt(planStep.count);
+        out.append(" timed, ");
+        printLatency(out, planStep);
+        out.append("selectFacilities: ");
+        out.appendInt(stats.counters[Metrics::FACILITIES_STARTED]);
+        out.append(" selections, ");
+        out.appendInt(selectFacility.count);
+        out.append(" timed refills, ");
+        printLatency(out, selectFacility);
+        out.append("Facilities: ");
+        out.appendInt(stats.counters[Metrics::FACILITIES_STARTED]);
+        out.append(" started, ");
+        out.appendInt(stats.counters[Metrics::FACILITIES_COMPLETED]);
+        out.append(" completed\nLast step command: ");
+        out.appendInt(stats.gauges[Metrics::LAST_STEP_STEPS]);
+        out.append(" steps, ");
+        out.appendInt(stats.gauges[Metrics::LAST_STEP_STARTED]);
+        out.append(" started, ");
+        out.appendInt(stats.gauges[Metrics::LAST_STEP_COMPLETED]);
+        out.append(" completed\nPlans: ");
+        out.appendInt(available);
+        out.append(" AVAILABLE, ");
+        out.appendInt(busy);
+        out.append(" BUSY\nLog: ");
+        out.appendInt(log.size());
+        out.append(" actions, ");
+        out.appendInt(log.getNumOfBytes());
+        out.append(" bytes\n");
+    }
+    out.flush();
+    complete();
+}
+
+void PrintStats::print(OutputBuffer &out) const {
+    out.append("stats ");
+    if (!format.empty()) {
+        out.append(format);
+        out.append(' ');
+    }
+    out.append(statusName(getStatus()));
+}
+
+PrintStats* PrintStats::clone() const {
+    return new PrintStats(*this);
+}
+
+void PrintStats::saveArguments(BinaryWriter &writer) const {
+    writer.writeByte(PRINT_STATS_TAG);
+    writer.writeString(format);
+}
+
+OptimizePlan::OptimizePlan(const int planId, const int horizon, const string &objective)
+    : planId(planId), horizon(horizon), objective(objective) {}
+
+void OptimizePlan::act(Simulation &simulation) {
+    PolicySearch::Objective goal;
+    if (!simulation.isPlanExists(planId)) {
+        error("Plan doesn't exist");
+        return;
+    }
+    if (horizon < 1) {
+        error("Horizon must be at least one step");
+        return;
+    }
+    if (!PolicySearch::parseObjective(objective, goal)) {
+        error("Unknown objective");
+        return;
+    }
+
+    const Plan plan = simulation.copyPlan(planId);
+    PolicySearch::Result result = PolicySearch::search(plan, simulation.getFacilitiesOptions(), horizon, goal,
+                                                       simulation.getThreadPool());
+
+    OutputBuffer& out = output();
+    out.append("PlanID: ");
+    out.appendInt(planId);
+    out.append("\nObjective: ");
+    out.append(objective);
+    out.append("\nHorizon: ");
+    out.appendInt(horizon);
+    out.append(" steps, ");
+    out.appendInt(result.numOfSchedules);
+    out.append(" schedules tried\nSchedule: ");
+    // Consecutive segments with the same policy are one stretch.
+    int stretch = 0;
+    bool first = true;
+    for (size_t segment = 0; segment < result.schedule.size(); segment++) {
+        int steps = std::min(result.segmentLength, horizon - static_cast<int>(segment) * result.segmentLength);
+        stretch += steps;
+        if (segment + 1 < result.schedule.size() && result.schedule[segment + 1] == result.schedule[segment]) {
+            continue;
+        }
+        if (!first) {
+            out.append(", ");
+        }
+        first = false;
+        out.append(PolicySearch::getPolicyName(result.schedule[segment]));
+        out.append(" for ");
+        out.appendInt(stretch);
+        out.append(stretch == 1 ? " step" : " steps");
+        stretch = 0;
+    }
+    out.append("\nLifeQualityScore: ");
+    out.appendInt(result.lifeQualityScore);
+    out.append("\nEconomyScore: ");
+    out.appendInt(result.economyScore);
+    out.append("\nEnvironmentScore: ");
+    out.appendInt(result.environmentScore);
+    out.append('\n');
+    out.flush();
+    complete();
+}
+
+void OptimizePlan::print(OutputBuffer &out) const {
+    out.append("optimize ");
+    out.appendInt(planId);
+    out.append(' ');
+    out.appendInt(horizon);
+    out.append(' ');
+    out.append(objective);
+    out.append(' ');
+    out.append(statusName(getStatus()));
+}
+
+OptimizePlan* OptimizePlan::clone() const {
+    return new OptimizePlan(*this);
+}
+
+void OptimizePlan::saveArguments(BinaryWriter &writer) const {
+    writer.writeByte(OPTIMIZE_PLAN_TAG);
+    writer.writeSignedVarint(planId);
+    writer.writeSignedVarint(horizon);
+    writer.writeString(objective);
+}
+
+TopPlans::TopPlans(const string &metric, const int count) : metric(metric), count(count) {}
+
+void TopPlans::act(Simulation &simulation) {
+    PlanIndex::Metric score;
+    if (!PlanIndex::parseMetric(metric, score)) {
+        error("Unknown metric");
+        return;
+    }
+    if (count < 1) {
+        error("Count must be at least one");
+        return;
+    }
+
+    const vector<int> planIds = simulation.getPlanIndex().top(score, count);
+    OutputBuffer& out = output();
+    for (size_t rank = 0; rank < planIds.size(); rank++) {
+        const Plan& plan = simulation.viewPlan(planIds[rank]);
+        out.appendInt(rank + 1);
+        out.append(". PlanID: ");
+        out.appendInt(planIds[rank]);
+        out.append(", SettlementName: ");
+        out.append(plan.getSettlementName());
+        out.append(", ");
+        out.append(PlanIndex::getScoreName(score));
+        out.append(": ");
+        out.appendInt(PlanIndex::getScore(plan, score));
+        out.append('\n');
+    }
+    out.flush();
+    complete();
+}
+
+void TopPlans::print(OutputBuffer &out) const {
+    out.append("top ");
+    out.append(metric);
+    out.append(' ');
+    out.appendInt(count);
+    out.append(' ');
+    out.append(statusName(getStatus()));
+}
+
+TopPlans* TopPlans::clone() const {
+    return new TopPlans(*this);
+}
+
+void TopPlans::saveArguments(BinaryWriter &writer) const {
+    writer.writeByte(TOP_PLANS_TAG);
+    writer.writeString(metric);
+    writer.writeSignedVarint(count);
+}
+
+AggregatePlans::AggregatePlans(const string &metric, const string &grouping) : metric(metric), grouping(grouping) {}
+
+void AggregatePlans::act(Simulation &simulation) {
+    PlanIndex::Metric score;
+    PlanIndex::Grouping by;
+    if (!PlanIndex::parseMetric(metric, score)) {
+        error("Unknown metric");
+        return;
+    }
+    if (!PlanIndex::parseGrouping(grouping, by)) {
+        error("Unknown grouping");
+        return;
+    }
+
+    const vector<PlanIndex::Group> groups = simulation.getPlanIndex().aggregate(score, by);
+    OutputBuffer& out = output();
+    for (const PlanIndex::Group& group : groups) {
+        out.append(group.name);
+        out.append(": ");
+        out.appendInt(group.numOfPlans);
+        out.append(group.numOfPlans == 1 ? " plan, total " : " plans, total ");
+        out.append(PlanIndex::getScoreName(score));
+        out.append(' ');
+        out.appendInt(group.total);
+        out.append('\n');
+    }
+    out.flush();
+    complete();
+}
+
+void AggregatePlans::print(OutputBuffer &out) const {
+    out.append("aggregate ");
+    out.append(metric);
+    out.append(" by ");
+    out.append(grouping);
+    out.append(' ');
+    out.append(statusName(getStatus()));
+}
+
+AggregatePlans* AggregatePlans::clone() const {
+    return new AggregatePlans(*this);
+}
+
+void AggregatePlans::saveArguments(BinaryWriter &writer) const {
+    writer.writeByte(AGGREGATE_PLANS_TAG);
+    writer.writeString(metric);
+    writer.writeString(grouping);
+}
+
+BackupSimulation::BackupSimulation() : filePath() {}
+
+BackupSimulation::BackupSimulation(const string &filePath) : filePath(filePath) {}
 
 void BackupSimulation::act(Simulation &simulation) {
+    if (!filePath.empty()) {
+        try {
+            simulation.saveSnapshot(filePath);
+        } catch (const std::exception &e) {
+            error(e.what());
+            return;
+        }
+        complete();
+        return;
+    }
+
     extern Simulation* backup;
     if(backup != nullptr) {
         delete backup;
@@ -272,18 +846,40 @@ void BackupSimulation::act(Simulation &simulation) {
     complete();
 }
 
-const string BackupSimulation::toString() const {
-    string status = (getStatus() == ActionStatus::COMPLETED) ? "COMPLETED" : "ERROR";
-    return "backup " + status;
+void BackupSimulation::print(OutputBuffer &out) const {
+    out.append("backup ");
+    if (!filePath.empty()) {
+        out.append(filePath);
+        out.append(' ');
+    }
+    out.append(statusName(getStatus()));
 }
 
 BackupSimulation* BackupSimulation::clone() const {
     return new BackupSimulation(*this);
 }
 
-RestoreSimulation::RestoreSimulation() {}
+void BackupSimulation::saveArguments(BinaryWriter &writer) const {
+    writer.writeByte(BACKUP_SIMULATION_TAG);
+    writer.writeString(filePath);
+}
+
+RestoreSimulation::RestoreSimulation() : filePath() {}
+
+RestoreSimulation::RestoreSimulation(const string &filePath) : filePath(filePath) {}
 
 void RestoreSimulation::act(Simulation &simulation) {
+    if (!filePath.empty()) {
+        try {
+            simulation.loadSnapshot(filePath);
+        } catch (const std::exception &e) {
+            error(e.what());
+            return;
+        }
+        complete();
+        return;
+    }
+
     extern Simulation* backup;
     if(backup == nullptr) {
         error("No backup available");
@@ -294,11 +890,20 @@ void RestoreSimulation::act(Simulation &simulation) {
     complete();
 }
 
-const string RestoreSimulation::toString() const {
-    string status = (getStatus() == ActionStatus::COMPLETED) ? "COMPLETED" : "ERROR";
-    return "restore " + status;
+void RestoreSimulation::print(OutputBuffer &out) const {
+    out.append("restore ");
+    if (!filePath.empty()) {
+        out.append(filePath);
+        out.append(' ');
+    }
+    out.append(statusName(getStatus()));
 }
 
 RestoreSimulation* RestoreSimulation::clone() const {
     return new RestoreSimulation(*this);
+}
+
+void RestoreSimulation::saveArguments(BinaryWriter &writer) const {
+    writer.writeByte(RESTORE_SIMULATION_TAG);
+    writer.writeString(filePath);
 }
\ No newline at end of file
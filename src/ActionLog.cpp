@@ -0,0 +1,123 @@
+#include "ActionLog.h"
+#include <stdexcept>
+#include <unistd.h>
+
+ActionLog::ActionLog()
+    : segments(), names(std::make_shared<StringTable>()), spillFile(), encoder(), count(0), numOfBytes(0), firstResident(0) {}
+
+ActionLog::Segment::Segment() : bytes(), length(0), count(0), spillOffset(-1), spillFile() {}
+
+ActionLog::SpillFile::SpillFile() : file(std::tmpfile()), size(0) {
+    if (file == nullptr) {
+        throw std::runtime_error("Failed to create the action log spill file");
+    }
+}
+
+ActionLog::SpillFile::~SpillFile() {
+    std::fclose(file);
+}
+
+long ActionLog::SpillFile::write(const vector<char> &bytes) {
+    long offset = size;
+    if (::pwrite(fileno(file), &bytes[0], bytes.size(), offset) != static_cast<ssize_t>(bytes.size())) {
+        throw std::runtime_error("Failed to write the action log spill file");
+    }
+    size += static_cast<long>(bytes.size());
+    return offset;
+}
+
+void ActionLog::SpillFile::read(long offset, vector<char> &bytes) const {
+    if (::pread(fileno(file), &bytes[0], bytes.size(), offset) != static_cast<ssize_t>(bytes.size())) {
+        throw std::runtime_error("Failed to read the action log spill file");
+    }
+}
+
+/*
+Takes ownership of the action: it is encoded and then deleted.
+*/
+void ActionLog::append(BaseAction *action) {
+    encoder.clear();
+    encoder.setStringTable(names.get());
+    action->save(encoder);
+    delete action;
+    const vector<char>& encoded = encoder.getBuffer();
+
+    if (segments.empty() || segments.back()->length + encoded.size() > SEGMENT_BYTES) {
+        if (!segments.empty()) {
+            spillOldSegments();
+        }
+        segments.push_back(std::make_shared<Segment>());
+        segments.back()->bytes.reserve(SEGMENT_BYTES);
+    }
+    else if (segments.back().use_count() > 1) {
+        std::shared_ptr<Segment> copy = std::make_shared<Segment>(*segments.back());
+        copy->bytes.reserve(SEGMENT_BYTES);
+        segments.back() = copy;
+    }
+
+    Segment& last = *segments.back();
+    last.bytes.insert(last.bytes.end(), encoded.begin(), encoded.end());
+    last.length += encoded.size();
+    last.count++;
+    count++;
+    numOfBytes += encoded.size();
+}
+
+/*
+Writes out the oldest full segments until the ones still in memory fit the budget.
+A segment shared with a copy of the log may already have been written out by it.
+*/
+void ActionLog::spillOldSegments() {
+    const size_t numOfFull = segments.size();
+    while ((numOfFull - firstResident) * SEGMENT_BYTES > MEMORY_BUDGET) {
+        Segment& segment = *segments[firstResident];
+        if (segment.spillOffset == -1) {
+            if (spillFile == nullptr) {
+                spillFile = std::make_shared<SpillFile>();
+            }
+            segment.spillOffset = spillFile->write(segment.bytes);
+            segment.spillFile = spillFile;
+            vector<char>().swap(segment.bytes);
+        }
+        firstResident++;
+    }
+}
+
+size_t ActionLog::size() const {
+    return count;
+}
+
+// Encoded size of every action in the log, in memory or spilled.
+size_t ActionLog::getNumOfBytes() const {
+    return numOfBytes;
+}
+
+/*
+Decodes the actions one at a time, oldest first. Spilled segments are read back one
+segment at a time.
+*/
+void ActionLog::forEach(const std::function<void(const BaseAction&)> &visit) const {
+    vector<char> spilled;
+    for (const std::shared_ptr<Segment>& segment : segments) {
+        const char *begin = segment->bytes.empty() ? nullptr : &segment->bytes[0];
+        if (segment->spillOffset != -1) {
+            spilled.resize(segment->length);
+            segment->spillFile->read(segment->spillOffset, spilled);
+            begin = &spilled[0];
+        }
+
+        BinaryReader reader(begin, begin + segment->length);
+        reader.setStringTable(names.get());
+        for (size_t i = 0; i < segment->count; i++) {
+            std::unique_ptr<BaseAction> action(BaseAction::load(reader));
+            visit(*action);
+        }
+    }
+}
+
+void ActionLog::clear() {
+    segments.clear();
+    count = 0;
+    numOfBytes = 0;
+    firstResident = 0;
+}
@@ -0,0 +1,138 @@
+#include "BalanceIndex.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+
+BalanceIndex::BalanceIndex()
+    : points(), pointIndex(), cells(), cellSize(1),
+      minX(0), maxX(0), minY(0), maxY(0),
+      minCellX(0), maxCellX(0), minCellY(0), maxCellY(0), builtSize(0) {}
+
+long long BalanceIndex::key(int x, int y) {
+    return static_cast<long long>((static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y));
+}
+
+int BalanceIndex::floorDivide(int value, int divisor) {
+    int quotient = value / divisor;
+    if (value % divisor != 0 && value < 0) {
+        quotient--;
+    }
+    return quotient;
+}
+
+bool BalanceIndex::empty() const {
+    return points.empty();
+}
+
+void BalanceIndex::add(int index, int lifeQualityScore, int economyScore, int environmentScore) {
+    Point point = {lifeQualityScore - economyScore, lifeQualityScore - environmentScore, index};
+    if (!pointIndex.insert(std::make_pair(key(point.x, point.y), index)).second) {
+        return;
+    }
+
+    if (points.empty()) {
+        minX = maxX = point.x;
+        minY = maxY = point.y;
+    } else {
+        minX = std::min(minX, point.x);
+        maxX = std::max(maxX, point.x);
+        minY = std::min(minY, point.y);
+        maxY = std::max(maxY, point.y);
+    }
+    points.push_back(point);
+
+    // The cell size is picked for about one point per cell, and picked again each time
+    // the number of points doubles.
+    if (points.size() >= 2 * builtSize) {
+        rebuild();
+    } else {
+        insert(static_cast<int>(points.size()) - 1);
+    }
+}
+
+void BalanceIndex::rebuild() {
+    const double area = (static_cast<double>(maxX) - minX + 1) * (static_cast<double>(maxY) - minY + 1);
+    cellSize = std::max(1, static_cast<int>(std::sqrt(area / points.size())));
+    cells.clear();
+    minCellX = minCellY = INT_MAX;
+    maxCellX = maxCellY = INT_MIN;
+    for (size_t position = 0; position < points.size(); position++) {
+        insert(static_cast<int>(position));
+    }
+    builtSize = points.size();
+}
+
+void BalanceIndex::insert(int position) {
+    const int cellX = floorDivide(points[position].x, cellSize);
+    const int cellY = floorDivide(points[position].y, cellSize);
+    cells[key(cellX, cellY)].push_back(position);
+    minCellX = std::min(minCellX, cellX);
+    maxCellX = std::max(maxCellX, cellX);
+    minCellY = std::min(minCellY, cellY);
+    maxCellY = std::max(maxCellY, cellY);
+}
+
+void BalanceIndex::visitCell(int cellX, int cellY, int targetX, int targetY, int &bestDistance, int &bestIndex) const {
+    std::unordered_map<long long, vector<int>>::const_iterator cell = cells.find(key(cellX, cellY));
+    if (cell == cells.end()) {
+        return;
+    }
+    for (int position : cell->second) {
+        const Point& point = points[position];
+        const int x = point.x - targetX;
+        const int y = point.y - targetY;
+        const int pointDistance = std::max({abs(x), abs(y), abs(x - y)});
+        if (pointDistance < bestDistance || (pointDistance == bestDistance && point.index < bestIndex)) {
+            bestDistance = pointDistance;
+            bestIndex = point.index;
+        }
+    }
+}
+
+/*
+Returns the index of the first facility that leaves a plan with these scores most
+balanced, and sets distance to the balance distance the plan ends up with. The
+index must not be empty.
+*/
+int BalanceIndex::findNearest(int lifeQualityScore, int economyScore, int environmentScore, int &distance) const {
+    const int targetX = economyScore - lifeQualityScore;
+    const int targetY = environmentScore - lifeQualityScore;
+    const int targetCellX = floorDivide(targetX, cellSize);
+    const int targetCellY = floorDivide(targetY, cellSize);
+
+    // Rings that miss every occupied cell are skipped.
+    const int firstRing = std::max({0, minCellX - targetCellX, targetCellX - maxCellX, minCellY - targetCellY, targetCellY - maxCellY});
+    const int lastRing = std::max({targetCellX - minCellX, maxCellX - targetCellX, targetCellY - minCellY, maxCellY - targetCellY});
+
+    int bestDistance = INT_MAX;
+    int bestIndex = INT_MAX;
+    for (int ring = firstRing; ring <= lastRing; ring++) {
+        // Every point outside rings 0..ring-1 is more than (ring - 1) * cellSize away.
+        if (bestDistance <= static_cast<long long>(ring - 1) * cellSize) {
+            break;
+        }
+        const int top = std::max(targetCellY - ring, minCellY);
+        const int bottom = std::min(targetCellY + ring, maxCellY);
+        const int left = std::max(targetCellX - ring, minCellX);
+        const int right = std::min(targetCellX + ring, maxCellX);
+        for (int cellY = top; cellY <= bottom; cellY++) {
+            if (cellY == targetCellY - ring || cellY == targetCellY + ring) {
+                for (int cellX = left; cellX <= right; cellX++) {
+                    visitCell(cellX, cellY, targetX, targetY, bestDistance, bestIndex);
+                }
+            } else {
+                if (targetCellX - ring >= minCellX) {
+                    visitCell(targetCellX - ring, cellY, targetX, targetY, bestDistance, bestIndex);
+                }
+                if (ring > 0 && targetCellX + ring <= maxCellX) {
+                    visitCell(targetCellX + ring, cellY, targetX, targetY, bestDistance, bestIndex);
+                }
+            }
+        }
+    }
+
+    distance = bestDistance;
+    return bestIndex;
+}
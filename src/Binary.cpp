@@ -0,0 +1,216 @@
+#include "Binary.h"
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+StringTable::StringTable() : strings(), ids() {}
+
+uint64_t StringTable::intern(const string &value) {
+    std::unordered_map<string, uint64_t>::const_iterator found = ids.find(value);
+    if (found != ids.end()) {
+        return found->second;
+    }
+    uint64_t id = strings.size();
+    strings.push_back(value);
+    ids.emplace(value, id);
+    return id;
+}
+
+const string& StringTable::get(uint64_t id) const {
+    if (id >= strings.size()) {
+        throw std::runtime_error("Unknown string number");
+    }
+    return strings[id];
+}
+
+BinaryWriter::BinaryWriter() : buffer(), table(nullptr) {}
+
+void BinaryWriter::writeByte(uint8_t value) {
+    buffer.push_back(static_cast<char>(value));
+}
+
+void BinaryWriter::writeVarint(uint64_t value) {
+    while (value >= 0x80) {
+        buffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back(static_cast<char>(value));
+}
+
+void BinaryWriter::writeSignedVarint(int64_t value) {
+    writeVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void BinaryWriter::writeString(const string &value) {
+    if (table != nullptr) {
+        writeVarint(table->intern(value));
+        return;
+    }
+    writeVarint(value.size());
+    buffer.insert(buffer.end(), value.begin(), value.end());
+}
+
+void BinaryWriter::writeInts(const int *values, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t value = static_cast<uint32_t>(values[i]);
+        for (int shift = 0; shift < 32; shift += 8) {
+            buffer.push_back(static_cast<char>((value >> shift) & 0xff));
+        }
+    }
+}
+
+void BinaryWriter::writeBytes(const char *bytes, size_t count) {
+    buffer.insert(buffer.end(), bytes, bytes + count);
+}
+
+const vector<char>& BinaryWriter::getBuffer() const {
+    return buffer;
+}
+
+void BinaryWriter::writeToFile(const string &filePath) const {
+    std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file for writing: " + filePath);
+    }
+    if (!buffer.empty()) {
+        file.write(&buffer[0], buffer.size());
+    }
+    if (!file) {
+        throw std::runtime_error("Failed to write file: " + filePath);
+    }
+}
+
+void BinaryWriter::setStringTable(StringTable *table) {
+    this->table = table;
+}
+
+void BinaryWriter::clear() {
+    buffer.clear();
+}
+
+BinaryReader::BinaryReader(const char *begin, const char *end) : cursor(begin), end(end), table(nullptr) {}
+
+void BinaryReader::require(size_t count) const {
+    if (static_cast<size_t>(end - cursor) < count) {
+        throw std::runtime_error("Unexpected end of data");
+    }
+}
+
+uint8_t BinaryReader::readByte() {
+    require(1);
+    return static_cast<uint8_t>(*cursor++);
+}
+
+uint64_t BinaryReader::readVarint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte = readByte();
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Malformed varint");
+}
+
+int64_t BinaryReader::readSignedVarint() {
+    uint64_t value = readVarint();
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+int BinaryReader::readInt() {
+    int64_t value = readSignedVarint();
+    if (value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max()) {
+        throw std::runtime_error("Integer out of range");
+    }
+    return static_cast<int>(value);
+}
+
+size_t BinaryReader::readCount() {
+    uint64_t count = readVarint();
+    // Every counted item takes at least one byte, so a count can't exceed what is left.
+    if (count > static_cast<uint64_t>(end - cursor)) {
+        throw std::runtime_error("Count larger than the data");
+    }
+    return static_cast<size_t>(count);
+}
+
+string BinaryReader::readString() {
+    if (table != nullptr) {
+        return table->get(readVarint());
+    }
+    size_t length = readCount();
+    const char *bytes = readBytes(length);
+    return string(bytes, length);
+}
+
+void BinaryReader::readInts(int *values, size_t count) {
+    require(count * 4);
+    const unsigned char *bytes = reinterpret_cast<const unsigned char*>(cursor);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t value = static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+                         (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+        values[i] = static_cast<int>(value);
+        bytes += 4;
+    }
+    cursor += count * 4;
+}
+
+const char* BinaryReader::readBytes(size_t count) {
+    require(count);
+    const char *bytes = cursor;
+    cursor += count;
+    return bytes;
+}
+
+bool BinaryReader::atEnd() const {
+    return cursor == end;
+}
+
+void BinaryReader::setStringTable(const StringTable *table) {
+    this->table = table;
+}
+
+MappedFile::MappedFile(const string &filePath) : data(nullptr), size(0) {
+    int descriptor = ::open(filePath.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        throw std::runtime_error("Failed to open file: " + filePath);
+    }
+
+    struct stat info;
+    if (::fstat(descriptor, &info) != 0) {
+        ::close(descriptor);
+        throw std::runtime_error("Failed to read file: " + filePath);
+    }
+
+    size = static_cast<size_t>(info.st_size);
+    if (size > 0) {
+        void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (mapping == MAP_FAILED) {
+            ::close(descriptor);
+            throw std::runtime_error("Failed to map file: " + filePath);
+        }
+        ::madvise(mapping, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(mapping);
+    }
+    ::close(descriptor);
+}
+
+MappedFile::~MappedFile() {
+    if (data != nullptr) {
+        ::munmap(const_cast<char*>(data), size);
+    }
+}
+
+const char* MappedFile::begin() const {
+    return data;
+}
+
+const char* MappedFile::end() const {
+    return data + size;
+}
@@ -0,0 +1,235 @@
+#include "ConfigLoader.h"
+#include <cstring>
+#include <climits>
+#include <functional>
+#include <stdexcept>
+#include "Binary.h"
+#include "Simulation.h"
+#include "ThreadPool.h"
+
+// Files smaller than this are parsed on the calling thread alone.
+static const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static bool nextToken(const char *&cursor, const char *end, const char *&token, size_t &length) {
+    while (cursor < end && isSpace(*cursor)) {
+        cursor++;
+    }
+    token = cursor;
+    while (cursor < end && !isSpace(*cursor)) {
+        cursor++;
+    }
+    length = cursor - token;
+    return length > 0;
+}
+
+static bool tokenIs(const char *token, size_t length, const char *word) {
+    return length == std::strlen(word) && std::memcmp(token, word, length) == 0;
+}
+
+/*
+Plain decimal integers only: an optional sign followed by digits, with nothing after
+them. No locale, no stream state.
+*/
+static bool nextInt(const char *&cursor, const char *end, int &value) {
+    const char *token;
+    size_t length;
+    if (!nextToken(cursor, end, token, length)) {
+        return false;
+    }
+    const char *digit = token;
+    const char *last = token + length;
+    bool negative = false;
+    if (*digit == '-' || *digit == '+') {
+        negative = *digit == '-';
+        digit++;
+    }
+    if (digit == last) {
+        return false;
+    }
+    long long result = 0;
+    for (; digit < last; digit++) {
+        if (*digit < '0' || *digit > '9') {
+            return false;
+        }
+        result = result * 10 + (*digit - '0');
+        if (result > static_cast<long long>(INT_MAX) + 1) {
+            return false;
+        }
+    }
+    if (negative) {
+        result = -result;
+    }
+    if (result > INT_MAX) {
+        return false;
+    }
+    value = static_cast<int>(result);
+    return true;
+}
+
+static std::runtime_error lineError(const string &configFilePath, int lineNumber, const string &message) {
+    return std::runtime_error("Configuration file " + configFilePath + ", line " + std::to_string(lineNumber) + ": " + message);
+}
+
+ConfigLoader::Chunk::Chunk(const char *begin, const char *end)
+    : begin(begin), end(end), lines(), numOfLines(0), errorLine(0), error() {}
+
+/*
+Returns true and fills line for a settlement, facility or plan line. Returns false
+with an empty error for lines that are skipped, and false with the reason in error
+for a malformed line.
+*/
+bool ConfigLoader::parseLine(const char *cursor, const char *end, Line &line, string &error) {
+    const char *token;
+    size_t length;
+    if (!nextToken(cursor, end, token, length)) {
+        return false;
+    }
+
+    if (tokenIs(token, length, "settlement")) {
+        line.type = LineType::SETTLEMENT;
+        bool valid = nextToken(cursor, end, line.name, line.nameLength) && nextInt(cursor, end, line.values[0]) &&
+                     line.values[0] >= 0 && line.values[0] <= static_cast<int>(SettlementType::METROPOLIS);
+        // The construction cap is optional; 0 stands for the type's default.
+        line.values[1] = 0;
+        const char *rest = cursor;
+        if (valid && nextToken(rest, end, token, length)) {
+            valid = nextInt(cursor, end, line.values[1]) && line.values[1] >= 1 && line.values[1] <= Settlement::MAX_CONSTRUCTION_CAP;
+        }
+        if (!valid) {
+            error = "Invalid settlement line. Syntax: settlement <settlement_name> <settlement_type (0: village, 1: city, 2: metropolis)> [construction_cap]";
+            return false;
+        }
+        return true;
+    }
+    if (tokenIs(token, length, "facility")) {
+        line.type = LineType::FACILITY;
+        bool valid = nextToken(cursor, end, line.name, line.nameLength);
+        for (int i = 0; valid && i < 5; i++) {
+            valid = nextInt(cursor, end, line.values[i]);
+        }
+        if (!valid || line.values[0] < 0 || line.values[0] > static_cast<int>(FacilityCategory::ENVIRONMENT)) {
+            error = "Invalid facility line. Syntax: facility <facility_name> <category> <price> <lifeq_impact> <eco_impact> <env_impact>";
+            return false;
+        }
+        return true;
+    }
+    if (tokenIs(token, length, "plan")) {
+        line.type = LineType::PLAN;
+        if (!nextToken(cursor, end, line.name, line.nameLength) || !nextToken(cursor, end, token, length)) {
+            error = "Invalid plan line. Syntax: plan <settlement_name> <selection_policy>";
+            return false;
+        }
+        line.values[0] = SelectionPolicy::findPolicy(string(token, length));
+        if (line.values[0] == -1) {
+            error = "Unknown selection policy: " + string(token, length);
+            return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+void ConfigLoader::parseChunk(Chunk &chunk) {
+    const char *cursor = chunk.begin;
+    while (cursor < chunk.end) {
+        const char *lineEnd = static_cast<const char*>(std::memchr(cursor, '\n', chunk.end - cursor));
+        const char *next = chunk.end;
+        if (lineEnd == nullptr) {
+            lineEnd = chunk.end;
+        } else {
+            next = lineEnd + 1;
+        }
+        chunk.numOfLines++;
+
+        Line line;
+        line.lineNumber = chunk.numOfLines;
+        if (parseLine(cursor, lineEnd, line, chunk.error)) {
+            chunk.lines.push_back(line);
+        }
+        else if (!chunk.error.empty()) {
+            chunk.errorLine = chunk.numOfLines;
+            return;
+        }
+        cursor = next;
+    }
+}
+
+void ConfigLoader::load(const string &configFilePath, Simulation &simulation, ThreadPool *pool) {
+    MappedFile file(configFilePath);
+    const char *begin = file.begin();
+    const char *end = file.end();
+    if (begin == end) {
+        throw std::runtime_error("Configuration file is empty: " + configFilePath + "  ,Please add valid configFile and start again");
+    }
+
+    size_t size = end - begin;
+    size_t numOfChunks = 1;
+    if (pool != nullptr && size >= 2 * MIN_CHUNK_SIZE) {
+        numOfChunks = std::min(static_cast<size_t>(pool->getNumOfThreads()) * 4, size / MIN_CHUNK_SIZE);
+    }
+
+    vector<Chunk> chunks;
+    chunks.reserve(numOfChunks);
+    const char *chunkBegin = begin;
+    for (size_t i = 1; i < numOfChunks && chunkBegin < end; i++) {
+        const char *target = std::max(chunkBegin, begin + size / numOfChunks * i);
+        const char *newline = static_cast<const char*>(std::memchr(target, '\n', end - target));
+        const char *chunkEnd = newline == nullptr ? end : newline + 1;
+        chunks.push_back(Chunk(chunkBegin, chunkEnd));
+        chunkBegin = chunkEnd;
+    }
+    if (chunkBegin < end) {
+        chunks.push_back(Chunk(chunkBegin, end));
+    }
+
+    if (chunks.size() > 1) {
+        vector<std::function<void()>> tasks;
+        for (Chunk &chunk : chunks) {
+            tasks.push_back([&chunk] { parseChunk(chunk); });
+        }
+        pool->run(tasks);
+    } else {
+        parseChunk(chunks[0]);
+    }
+
+    // Applied in file order, so a plan only sees the settlements defined above it.
+    int firstLine = 0;
+    for (const Chunk &chunk : chunks) {
+        for (const Line &line : chunk.lines) {
+            string name(line.name, line.nameLength);
+            string error;
+            if (line.type == LineType::SETTLEMENT) {
+                SettlementType type = static_cast<SettlementType>(line.values[0]);
+                int constructionCap = line.values[1] > 0 ? line.values[1] : Settlement::getDefaultConstructionCap(type);
+                Settlement *settlement = new Settlement(name, type, constructionCap);
+                if (!simulation.addSettlement(settlement)) {
+                    delete settlement;
+                    error = "Settlement already exists: " + name;
+                }
+            }
+            else if (line.type == LineType::FACILITY) {
+                if (!simulation.addFacility(FacilityType(name, static_cast<FacilityCategory>(line.values[0]),
+                                                         line.values[1], line.values[2], line.values[3], line.values[4]))) {
+                    error = "Facility already exists: " + name;
+                }
+            }
+            else if (!simulation.isSettlementExists(name)) {
+                error = "Unknown settlement: " + name;
+            }
+            else {
+                simulation.addPlan(simulation.getSettlement(name), SelectionPolicy::create(line.values[0], 0, 0, 0));
+            }
+            if (!error.empty()) {
+                throw lineError(configFilePath, firstLine + line.lineNumber, error);
+            }
+        }
+        if (!chunk.error.empty()) {
+            throw lineError(configFilePath, firstLine + chunk.errorLine, chunk.error);
+        }
+        firstLine += chunk.numOfLines;
+    }
+}
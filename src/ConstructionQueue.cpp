@@ -0,0 +1,132 @@
+#include "ConstructionQueue.h"
+#include <algorithm>
+
+const int ConstructionQueue::EMPTY;
+
+ConstructionQueue::ConstructionQueue() : clock(0), slots(), pending(), completedSlots(), renumbered(), numOfEmptySlots(0) {}
+
+int ConstructionQueue::size() const {
+    return static_cast<int>(slots.size()) - numOfEmptySlots;
+}
+
+bool ConstructionQueue::empty() const {
+    return size() == 0;
+}
+
+void ConstructionQueue::push(int typeIndex, int buildTime) {
+    Slot slot = {typeIndex, buildTime};
+    if (buildTime > 0) {
+        slot.due = clock + buildTime;
+        Pending entry = {slot.due, static_cast<int>(slots.size())};
+        pending.push_back(entry);
+        std::push_heap(pending.begin(), pending.end(), IsLater());
+    }
+    slots.push_back(slot);
+}
+
+/*
+Advances the clock by one step and returns how many buildings finished. Which ones
+finished is kept until takeCompleted() is called.
+*/
+int ConstructionQueue::step() {
+    clock++;
+    while (!pending.empty() && pending.front().due <= clock) {
+        std::pop_heap(pending.begin(), pending.end(), IsLater());
+        completedSlots.push_back(pending.back().slot);
+        pending.pop_back();
+    }
+    return static_cast<int>(completedSlots.size());
+}
+
+/*
+How many steps until the first building finishes, or -1 if none of them ever will.
+*/
+int ConstructionQueue::nextCompletion() const {
+    if (pending.empty()) {
+        return -1;
+    }
+    return static_cast<int>(pending.front().due - clock);
+}
+
+/*
+Counts every building down by several steps at once. The caller makes sure no building
+finishes on the way (steps is less than nextCompletion()).
+*/
+void ConstructionQueue::advance(long long steps) {
+    clock += steps;
+}
+
+// The heap pops buildings due at the same tick in slot order, so completedSlots is sorted.
+void ConstructionQueue::takeCompleted(PoolVector<int> &completedTypes) {
+    for (int slot : completedSlots) {
+        completedTypes.push_back(slots[slot].typeIndex);
+        slots[slot].typeIndex = EMPTY;
+    }
+    numOfEmptySlots += static_cast<int>(completedSlots.size());
+    completedSlots.clear();
+
+    if (numOfEmptySlots >= MIN_EMPTY_SLOTS && 2 * numOfEmptySlots >= static_cast<int>(slots.size())) {
+        compact();
+    }
+}
+
+/*
+Saves the buildings as they are stepsBehind steps after the queue's clock; the
+caller makes sure none of them finishes in between.
+*/
+void ConstructionQueue::save(BinaryWriter &writer, long long stepsBehind) const {
+    vector<int> typeIndices;
+    vector<int> timesLeft;
+    typeIndices.reserve(size());
+    timesLeft.reserve(size());
+    forEach([&typeIndices, &timesLeft, stepsBehind](int typeIndex, int timeLeft) {
+        typeIndices.push_back(typeIndex);
+        timesLeft.push_back(timeLeft > 0 ? static_cast<int>(timeLeft - stepsBehind) : timeLeft);
+    });
+
+    writer.writeVarint(typeIndices.size());
+    if (!typeIndices.empty()) {
+        writer.writeInts(&typeIndices[0], typeIndices.size());
+        writer.writeInts(&timesLeft[0], timesLeft.size());
+    }
+}
+
+void ConstructionQueue::load(BinaryReader &reader) {
+    size_t count = reader.readCount();
+    vector<int> typeIndices(count);
+    vector<int> timesLeft(count);
+    if (count > 0) {
+        reader.readInts(&typeIndices[0], count);
+        reader.readInts(&timesLeft[0], count);
+    }
+
+    *this = ConstructionQueue();
+    slots.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        push(typeIndices[i], timesLeft[i]);
+    }
+}
+
+int ConstructionQueue::getTimeLeft(const Slot &slot) const {
+    return static_cast<int>(slot.due > 0 ? slot.due - clock : slot.due);
+}
+
+/*
+Drops the empty slots. Slots keep their relative order, so renumbering the pending
+entries leaves the heap valid.
+*/
+void ConstructionQueue::compact() {
+    renumbered.resize(slots.size());
+    size_t kept = 0;
+    for (size_t i = 0; i < slots.size(); i++) {
+        if (slots[i].typeIndex != EMPTY) {
+            renumbered[i] = static_cast<int>(kept);
+            slots[kept++] = slots[i];
+        }
+    }
+    slots.resize(kept);
+    for (Pending &entry : pending) {
+        entry.slot = renumbered[entry.slot];
+    }
+    numOfEmptySlots = 0;
+}
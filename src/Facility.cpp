@@ -41,68 +41,50 @@ FacilityCategory FacilityType::getCategory() const {
     return category;
 }
 
-Facility::Facility(const string &name, const string &settlementName, FacilityCategory category, int price, int lifeQuality_score, int economy_score, int environment_score)
-    : FacilityType(name, category, price, lifeQuality_score, economy_score, environment_score),
-     settlementName(settlementName), 
+Facility::Facility(int typeIndex, const FacilityType &type)
+    : typeIndex(typeIndex),
      status(FacilityStatus::UNDER_CONSTRUCTIONS),
-      timeLeft(price) {}
+      timeLeft(type.getCost()) {}
 
-Facility::Facility(const FacilityType &type, const string &settlementName)
-    : FacilityType(type), 
-    settlementName(settlementName),
-     status(FacilityStatus::UNDER_CONSTRUCTIONS),
-      timeLeft(price) {}
+Facility::Facility(int typeIndex, FacilityStatus status, int timeLeft)
+    : typeIndex(typeIndex),
+     status(status),
+      timeLeft(timeLeft) {}
 
 
 Facility::Facility(const Facility& other)
-    : FacilityType(other), 
-      settlementName(other.settlementName),
+    : typeIndex(other.typeIndex),
       status(other.status),
       timeLeft(other.timeLeft) {}
 
 
-const string& Facility::getSettlementName() const {
-    return settlementName;
+int Facility::getTypeIndex() const {
+    return typeIndex;
 }
 
 int Facility::getTimeLeft() const {
     return timeLeft;
 }
 
-FacilityStatus Facility::step() {
-    if (timeLeft > 0) {
-        timeLeft--;
-
-        if (timeLeft == 0) {
-            status = FacilityStatus::OPERATIONAL;
-        }
-    }
-    return status;
-}
-
-void Facility::setStatus(FacilityStatus status) {
-    this->status = status;
-}
-
 const FacilityStatus& Facility::getStatus() const {
     return status;
 }
 
-const string Facility::toString() const  {
-    string result = "Facility: " + getName() + "\n";
+const string Facility::toString(const FacilityType &type, const string &settlementName) const  {
+    string result = "Facility: " + type.getName() + "\n";
     result += "Category: ";
-    if (getCategory() == FacilityCategory::LIFE_QUALITY) {
+    if (type.getCategory() == FacilityCategory::LIFE_QUALITY) {
         result += "Life Quality\n";
-    } else if (getCategory() == FacilityCategory::ECONOMY) {
+    } else if (type.getCategory() == FacilityCategory::ECONOMY) {
         result += "Economy\n";
-    } else if (getCategory() == FacilityCategory::ENVIRONMENT) {
+    } else if (type.getCategory() == FacilityCategory::ENVIRONMENT) {
         result += "Environment\n";
     }
-    result += "Build Time: " + to_string(getCost()) + "\n";
-    result += "Life Quality Score: " + to_string(getLifeQualityScore()) + "\n";
-    result += "Economy Score: " + to_string(getEconomyScore()) + "\n";
-    result += "Environment Score: " + to_string(getEnvironmentScore()) + "\n";
-    result += "Settlement: " + getSettlementName() + "\n";
+    result += "Build Time: " + to_string(type.getCost()) + "\n";
+    result += "Life Quality Score: " + to_string(type.getLifeQualityScore()) + "\n";
+    result += "Economy Score: " + to_string(type.getEconomyScore()) + "\n";
+    result += "Environment Score: " + to_string(type.getEnvironmentScore()) + "\n";
+    result += "Settlement: " + settlementName + "\n";
     result += "Status: ";
     if (getStatus() == FacilityStatus::UNDER_CONSTRUCTIONS) {
         result += "Under Construction\n";
@@ -0,0 +1,78 @@
+#include "FacilityCatalog.h"
+#include <algorithm>
+
+FacilityCatalog::FacilityCatalog() : options(), nameIndex(), categories(), balance() {}
+
+bool FacilityCatalog::add(const FacilityType &facility) {
+    const int index = size();
+    if (!nameIndex.insert(std::make_pair(facility.getName(), index)).second) {
+        return false;
+    }
+    options.push_back(facility);
+    categories[static_cast<int>(facility.getCategory())].push_back(index);
+    balance.add(index, facility.getLifeQualityScore(), facility.getEconomyScore(), facility.getEnvironmentScore());
+    return true;
+}
+
+bool FacilityCatalog::contains(const string &facilityName) const {
+    return nameIndex.count(facilityName) > 0;
+}
+
+bool FacilityCatalog::empty() const {
+    return options.empty();
+}
+
+void FacilityCatalog::reserve(size_t count) {
+    options.reserve(count);
+    nameIndex.reserve(count);
+}
+
+const vector<FacilityType>& FacilityCatalog::getOptions() const {
+    return options;
+}
+
+/*
+The index of the first entry of the category after lastIndex, going round to the
+category's first entry after the last one (lastIndex -1 means from the start).
+position is where lastIndex sits in getCategory(category); it is updated to the
+returned entry's position. When it is out of date, e.g. for a fresh or restored
+policy, it is found again with a binary search. The category must not be empty.
+*/
+int FacilityCatalog::nextInCategory(FacilityCategory category, int lastIndex, int &position) const {
+    const vector<int>& indices = getCategory(category);
+    const int count = static_cast<int>(indices.size());
+    if (position < 0 || position >= count || indices[position] != lastIndex) {
+        position = static_cast<int>(std::upper_bound(indices.begin(), indices.end(), lastIndex) - indices.begin()) - 1;
+    }
+    position = position + 1 < count ? position + 1 : 0;
+    return indices[position];
+}
+
+/*
+The next count entries of the category after lastIndex, appended to selected: the
+same as count calls to the function above, with only the first one searching.
+Returns the last of them.
+*/
+int FacilityCatalog::nextInCategory(FacilityCategory category, int lastIndex, int &position, int count, vector<int> &selected) const {
+    if (count <= 0) {
+        return lastIndex;
+    }
+    const vector<int>& indices = getCategory(category);
+    const int size = static_cast<int>(indices.size());
+    lastIndex = nextInCategory(category, lastIndex, position);
+    selected.push_back(lastIndex);
+    for (int i = 1; i < count; i++) {
+        position = position + 1 < size ? position + 1 : 0;
+        lastIndex = indices[position];
+        selected.push_back(lastIndex);
+    }
+    return lastIndex;
+}
+
+/*
+The first entry that leaves a plan with these scores most balanced, see BalanceIndex.
+The catalog must not be empty.
+*/
+int FacilityCatalog::findMostBalancing(int lifeQualityScore, int economyScore, int environmentScore, int &distance) const {
+    return balance.findNearest(lifeQualityScore, economyScore, environmentScore, distance);
+}
@@ -0,0 +1,203 @@
+#include "MemoryPool.h"
+#include <atomic>
+#include <new>
+#include <sys/mman.h>
+
+// Pools are told apart by id rather than address, since a new pool may reuse a dead one's.
+static std::atomic<uint64_t> nextPoolId(1);
+static thread_local const std::shared_ptr<MemoryPool> *activeScope = nullptr;
+
+thread_local uint64_t MemoryPool::cachedPoolId = 0;
+thread_local MemoryPool::Shard *MemoryPool::cachedShard = nullptr;
+
+MemoryPool::Scope::Scope(const std::shared_ptr<MemoryPool> *pool) : previous(activeScope) {
+    activeScope = pool;
+}
+
+MemoryPool::Scope::~Scope() {
+    activeScope = previous;
+}
+
+const std::shared_ptr<MemoryPool>* MemoryPool::Scope::getActive() {
+    return activeScope;
+}
+
+MemoryPool::Shard::Shard()
+    : owner(std::this_thread::get_id()),
+      blockCursor(nullptr),
+      blockEnd(nullptr),
+      freeLists() {}
+
+MemoryPool::MemoryPool()
+    : id(nextPoolId++),
+      shardsLock(),
+      shards(),
+      regions(),
+      regionCursor(nullptr),
+      regionEnd(nullptr),
+      released(false) {}
+
+MemoryPool::~MemoryPool() {
+    for (Shard* shard : shards) {
+        delete shard;
+    }
+    for (const std::pair<char*, size_t>& region : regions) {
+        ::munmap(region.first, region.second);
+    }
+}
+
+void* MemoryPool::allocate(size_t size) {
+    const size_t sizeClass = getSizeClass(size);
+    if (sizeClass == NUM_OF_SIZE_CLASSES) {
+        return ::operator new(size);
+    }
+
+    Shard& shard = getShard();
+    FreeNode* &freeList = shard.freeLists[sizeClass];
+    if (freeList != nullptr) {
+        FreeNode* node = freeList;
+        freeList = node->next;
+        return node;
+    }
+
+    const size_t classSize = getClassSize(sizeClass);
+    if (shard.blockCursor == nullptr || static_cast<size_t>(shard.blockEnd - shard.blockCursor) < classSize) {
+        char* block = takeBlock();
+        shard.blockCursor = block;
+        shard.blockEnd = block + BLOCK_SIZE;
+    }
+    void* pointer = shard.blockCursor;
+    shard.blockCursor += classSize;
+    return pointer;
+}
+
+void MemoryPool::deallocate(void* pointer, size_t size) {
+    if (pointer == nullptr) {
+        return;
+    }
+    const size_t sizeClass = getSizeClass(size);
+    if (sizeClass == NUM_OF_SIZE_CLASSES) {
+        ::operator delete(pointer);
+        return;
+    }
+    if (released) {
+        return;
+    }
+
+    FreeNode* node = static_cast<FreeNode*>(pointer);
+    FreeNode* &freeList = getShard().freeLists[sizeClass];
+    node->next = freeList;
+    freeList = node;
+}
+
+/*
+Called by the last simulation holding the pool, just before its members are destroyed:
+their memory goes back with the blocks, so freeing it object by object is skipped.
+Nothing may be allocated from the pool afterwards.
+*/
+void MemoryPool::release() {
+    released = true;
+}
+
+MemoryPool* MemoryPool::current() {
+    return activeScope != nullptr ? activeScope->get() : nullptr;
+}
+
+void* MemoryPool::allocateObject(size_t size) {
+    MemoryPool* pool = current();
+    char* memory = static_cast<char*>(pool != nullptr ? pool->allocate(size + HEADER_SIZE) : ::operator new(size + HEADER_SIZE));
+    *reinterpret_cast<MemoryPool**>(memory) = pool;
+    return memory + HEADER_SIZE;
+}
+
+void MemoryPool::deallocateObject(void* pointer, size_t size) {
+    if (pointer == nullptr) {
+        return;
+    }
+    char* memory = static_cast<char*>(pointer) - HEADER_SIZE;
+    MemoryPool* pool = *reinterpret_cast<MemoryPool**>(memory);
+    if (pool != nullptr) {
+        pool->deallocate(memory, size + HEADER_SIZE);
+    } else {
+        ::operator delete(memory);
+    }
+}
+
+// NUM_OF_SIZE_CLASSES for a request the pool doesn't serve.
+size_t MemoryPool::getSizeClass(size_t size) {
+    if (size == 0 || size > MAX_SIZE) {
+        return NUM_OF_SIZE_CLASSES;
+    }
+    if (size <= NUM_OF_SMALL_CLASSES * GRANULE) {
+        return (size - 1) / GRANULE;
+    }
+    size_t sizeClass = NUM_OF_SMALL_CLASSES;
+    size_t doubling = NUM_OF_SMALL_CLASSES * GRANULE;
+    while (2 * doubling < size) {
+        doubling *= 2;
+        sizeClass += STEPS_PER_DOUBLING;
+    }
+    const size_t step = doubling / STEPS_PER_DOUBLING;
+    return sizeClass + (size - doubling - 1) / step;
+}
+
+size_t MemoryPool::getClassSize(size_t sizeClass) {
+    if (sizeClass < NUM_OF_SMALL_CLASSES) {
+        return (sizeClass + 1) * GRANULE;
+    }
+    const size_t doublings = (sizeClass - NUM_OF_SMALL_CLASSES) / STEPS_PER_DOUBLING;
+    const size_t doubling = (NUM_OF_SMALL_CLASSES * GRANULE) << doublings;
+    return doubling + (sizeClass - NUM_OF_SMALL_CLASSES - doublings * STEPS_PER_DOUBLING + 1) * (doubling / STEPS_PER_DOUBLING);
+}
+
+MemoryPool::Shard& MemoryPool::getShard() {
+    if (cachedPoolId == id) {
+        return *cachedShard;
+    }
+    return addShard();
+}
+
+// The first time a thread uses the pool since it last used another one.
+MemoryPool::Shard& MemoryPool::addShard() {
+    std::lock_guard<std::mutex> guard(shardsLock);
+    const std::thread::id thread = std::this_thread::get_id();
+    Shard* found = nullptr;
+    for (Shard* shard : shards) {
+        if (shard->owner == thread) {
+            found = shard;
+        }
+    }
+    if (found == nullptr) {
+        found = new Shard();
+        shards.push_back(found);
+    }
+    cachedPoolId = id;
+    cachedShard = found;
+    return *found;
+}
+
+/*
+Cuts the next block out of the current region, reserving a new one when it is used
+up. Without overcommit a smaller reservation may still fit, so the size is halved
+until one does.
+*/
+char* MemoryPool::takeBlock() {
+    std::lock_guard<std::mutex> guard(shardsLock);
+    if (regionCursor == regionEnd) {
+        size_t size = REGION_SIZE;
+        void* region = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        while (region == MAP_FAILED && size > BLOCK_SIZE) {
+            size /= 2;
+            region = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        }
+        if (region == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        regions.push_back(std::make_pair(static_cast<char*>(region), size));
+        regionCursor = static_cast<char*>(region);
+        regionEnd = regionCursor + size;
+    }
+    char* block = regionCursor;
+    regionCursor += BLOCK_SIZE;
+    return block;
+}
@@ -0,0 +1,128 @@
+#include "Metrics.h"
+#include <cmath>
+#include <memory>
+#include <mutex>
+
+std::atomic<uint64_t> Metrics::gauges[Metrics::NUM_OF_GAUGES];
+
+static const char *TIMER_NAMES[Metrics::NUM_OF_TIMERS] = {
+    "step", "plan", "settlement", "facility", "planStatus", "changePolicy", "log", "close", "backup",
+    "restore", "stats", "optimize", "top", "aggregate", "simulation_step", "plan_step", "select_facility",
+};
+
+/*
+Every shard that was ever handed out, so the counts of threads that have finished
+(a pool that was replaced) still show up in snapshots.
+*/
+struct ShardRegistry {
+    ShardRegistry() : lock(), shards() {}
+    std::mutex lock;
+    vector<std::unique_ptr<Metrics::Shard>> shards;
+};
+
+static ShardRegistry& registry() {
+    static ShardRegistry instance;
+    return instance;
+}
+
+Metrics::Histogram::Histogram() : count(0), errors(0), totalNanoseconds(0), maxNanoseconds(0), buckets() {}
+
+/*
+The upper end of the bucket the given fraction of the samples falls in, so the
+result is at most twice the real value.
+*/
+uint64_t Metrics::Histogram::percentile(double fraction) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::ceil(fraction * count));
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < NUM_OF_BUCKETS; bucket++) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            uint64_t upper = bucket == 0 ? 0 : (bucket >= 63 ? UINT64_MAX : (uint64_t(1) << bucket) - 1);
+            return upper < maxNanoseconds ? upper : maxNanoseconds;
+        }
+    }
+    return maxNanoseconds;
+}
+
+Metrics::Snapshot::Snapshot() : counters(), gauges(), timers() {}
+
+Metrics::Shard::Shard() : padding(), counters(), counts(), errors(), totals(), maxima(), buckets() {}
+
+Metrics::Shard* Metrics::registerThread() {
+    ShardRegistry& shards = registry();
+    std::lock_guard<std::mutex> guard(shards.lock);
+    shards.shards.emplace_back(new Shard());
+    current() = shards.shards.back().get();
+    return current();
+}
+
+Metrics::Pause::Pause() : previous(current()) {
+    static thread_local Shard discarded;
+    current() = &discarded;
+}
+
+Metrics::Pause::~Pause() {
+    current() = previous;
+}
+
+const char* Metrics::getTimerName(Timer timer) {
+    return TIMER_NAMES[timer];
+}
+
+void Metrics::set(Gauge gauge, uint64_t value) {
+    gauges[gauge].store(value, std::memory_order_relaxed);
+}
+
+// Bucket b holds durations of b significant bits: [2^(b-1), 2^b).
+void Metrics::record(Timer timer, uint64_t nanoseconds) {
+    Shard& mine = shard();
+    int bucket = nanoseconds == 0 ? 0 : 64 - __builtin_clzll(nanoseconds);
+    if (bucket >= NUM_OF_BUCKETS) {
+        bucket = NUM_OF_BUCKETS - 1;
+    }
+    bump(mine.counts[timer], 1);
+    bump(mine.totals[timer], nanoseconds);
+    bump(mine.buckets[timer][bucket], 1);
+    if (nanoseconds > mine.maxima[timer].load(std::memory_order_relaxed)) {
+        mine.maxima[timer].store(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+void Metrics::recordError(Timer timer) {
+    bump(shard().errors[timer], 1);
+}
+
+Metrics::Snapshot Metrics::snapshot() {
+    Snapshot result;
+    for (int gauge = 0; gauge < NUM_OF_GAUGES; gauge++) {
+        result.gauges[gauge] = gauges[gauge].load(std::memory_order_relaxed);
+    }
+
+    ShardRegistry& shards = registry();
+    std::lock_guard<std::mutex> guard(shards.lock);
+    for (const std::unique_ptr<Shard>& shard : shards.shards) {
+        for (int counter = 0; counter < NUM_OF_COUNTERS; counter++) {
+            result.counters[counter] += shard->counters[counter].load(std::memory_order_relaxed);
+        }
+        for (int timer = 0; timer < NUM_OF_TIMERS; timer++) {
+            Histogram& histogram = result.timers[timer];
+            histogram.count += shard->counts[timer].load(std::memory_order_relaxed);
+            histogram.errors += shard->errors[timer].load(std::memory_order_relaxed);
+            histogram.totalNanoseconds += shard->totals[timer].load(std::memory_order_relaxed);
+            uint64_t maximum = shard->maxima[timer].load(std::memory_order_relaxed);
+            if (maximum > histogram.maxNanoseconds) {
+                histogram.maxNanoseconds = maximum;
+            }
+            for (int bucket = 0; bucket < NUM_OF_BUCKETS; bucket++) {
+                histogram.buckets[bucket] += shard->buckets[timer][bucket].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,77 @@
+#include "OutputBuffer.h"
+#include <cstring>
+
+static const char DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+OutputBuffer::OutputBuffer(std::ostream &sink, size_t capacity) : sink(sink), block(capacity), length(0) {}
+
+void OutputBuffer::append(const char *text, size_t count) {
+    if (length + count > block.size()) {
+        flush();
+        // Too large to gather: it goes to the stream as it is.
+        if (count > block.size()) {
+            sink.write(text, count);
+            return;
+        }
+    }
+    std::memcpy(&block[length], text, count);
+    length += count;
+}
+
+void OutputBuffer::append(const char *text) {
+    append(text, std::strlen(text));
+}
+
+void OutputBuffer::append(const string &text) {
+    append(text.data(), text.size());
+}
+
+void OutputBuffer::append(char c) {
+    if (length == block.size()) {
+        flush();
+    }
+    block[length++] = c;
+}
+
+void OutputBuffer::appendInt(long long value) {
+    char digits[20];
+    char *end = digits + sizeof(digits);
+    char *first = end;
+    // Worked on as unsigned so the most negative value can be negated.
+    unsigned long long magnitude = value < 0 ? 0ULL - static_cast<unsigned long long>(value)
+                                             : static_cast<unsigned long long>(value);
+    while (magnitude >= 100) {
+        unsigned index = static_cast<unsigned>(magnitude % 100) * 2;
+        magnitude /= 100;
+        *--first = DIGIT_PAIRS[index + 1];
+        *--first = DIGIT_PAIRS[index];
+    }
+    if (magnitude >= 10) {
+        unsigned index = static_cast<unsigned>(magnitude) * 2;
+        *--first = DIGIT_PAIRS[index + 1];
+        *--first = DIGIT_PAIRS[index];
+    } else {
+        *--first = static_cast<char>('0' + magnitude);
+    }
+    if (value < 0) {
+        *--first = '-';
+    }
+    append(first, end - first);
+}
+
+void OutputBuffer::flush() {
+    if (length > 0) {
+        sink.write(&block[0], length);
+        length = 0;
+    }
+}
@@ -1,69 +1,89 @@
 #include "Plan.h"
-#include <iostream>
 #include <string>
+#include <unordered_map>
+#include <stdexcept>
+#include "Metrics.h"
 
 using namespace std;
 
-Plan::Plan(const int planId, const Settlement &settlement, SelectionPolicy *selectionPolicy, const vector<FacilityType> &facilityOptions)
+// The settlement is shared, normally with the simulation that registered it.
+Plan::Plan(const int planId, const std::shared_ptr<const Settlement> &settlement, SelectionPolicy *selectionPolicy)
     : plan_id(planId),
-      settlement(*new Settlement(settlement)), 
-      construction_cap(static_cast<int>(settlement.getType()) + 1),
+      settlement(settlement),
+      construction_cap(settlement->getConstructionCap()),
       selectionPolicy(selectionPolicy),
       status(PlanStatus::AVALIABLE),
       facilities(),
+      listsFacilities(true),
+      numOfFacilities(0),
       underConstruction(),
-      facilityOptions(facilityOptions),
+      completedTypes(),
+      selectedTypes(),
       life_quality_score(0),
       economy_score(0),
       environment_score(0) {}
 
 Plan::Plan(const Plan& other)
     : plan_id(other.plan_id),
-      settlement(*new Settlement(other.settlement)), 
+      settlement(other.settlement), 
       construction_cap(other.construction_cap),
       selectionPolicy(other.selectionPolicy->clone()),
       status(other.status),
-      facilities(),
-      underConstruction(),
-      facilityOptions(other.facilityOptions),
+      facilities(other.facilities),
+      listsFacilities(other.listsFacilities),
+      numOfFacilities(other.numOfFacilities),
+      underConstruction(other.underConstruction),
+      completedTypes(),
+      selectedTypes(),
+      life_quality_score(other.life_quality_score),
+      economy_score(other.economy_score),
+      environment_score(other.environment_score) {}
+
+/*
+Takes over the other plan's policy and shares or takes the rest, so moving a plan
+allocates nothing. The plan moved from can only be destroyed or assigned to.
+*/
+Plan::Plan(Plan&& other) noexcept
+    : plan_id(other.plan_id),
+      settlement(std::move(other.settlement)),
+      construction_cap(other.construction_cap),
+      selectionPolicy(other.selectionPolicy),
+      status(other.status),
+      facilities(std::move(other.facilities)),
+      listsFacilities(other.listsFacilities),
+      numOfFacilities(other.numOfFacilities),
+      underConstruction(std::move(other.underConstruction)),
+      completedTypes(std::move(other.completedTypes)),
+      selectedTypes(std::move(other.selectedTypes)),
       life_quality_score(other.life_quality_score),
       economy_score(other.economy_score),
       environment_score(other.environment_score) {
-   
-    for (Facility* facility : other.facilities) {
-        facilities.push_back(new Facility(*facility));
-    }
+    other.selectionPolicy = nullptr;
+}
 
-    
-    for (Facility* facility : other.underConstruction) {
-        underConstruction.push_back(new Facility(*facility));
+Plan& Plan::operator=(Plan&& other) noexcept {
+    if (this != &other) {
+        delete selectionPolicy;
+        plan_id = other.plan_id;
+        settlement = std::move(other.settlement);
+        construction_cap = other.construction_cap;
+        selectionPolicy = other.selectionPolicy;
+        other.selectionPolicy = nullptr;
+        status = other.status;
+        facilities = std::move(other.facilities);
+        listsFacilities = other.listsFacilities;
+        numOfFacilities = other.numOfFacilities;
+        underConstruction = std::move(other.underConstruction);
+        completedTypes = std::move(other.completedTypes);
+        selectedTypes = std::move(other.selectedTypes);
+        life_quality_score = other.life_quality_score;
+        economy_score = other.economy_score;
+        environment_score = other.environment_score;
     }
+    return *this;
 }
 
-
-
-
 Plan::~Plan() {
-    if (&settlement!=nullptr){
-        delete &settlement; 
-
-
-    }
-
-    for (Facility* facility : facilities) {
-        if (facility!=nullptr){
-             delete facility;
-        }
-        
-       
-    }
-
-    for (Facility* facility : underConstruction) {
-        if (facility!=nullptr){
-            delete facility;
-        }
-    }
-
     delete selectionPolicy;
 }
 
@@ -87,89 +107,237 @@ void Plan::setSelectionPolicy(SelectionPolicy *selectionPolicy){
 }
 
 
-void Plan::step(){
+/*
+Built-in policies are passed as their own (final) classes, so the templates below call
+their canSelect() and selectFacility() directly and inline them. Custom policies are
+passed as SelectionPolicy and called through the vtable.
+*/
+void Plan::step(const FacilityCatalog &facilityOptions){
+    switch (selectionPolicy->getKind()) {
+        case PolicyKind::NAIVE: step(static_cast<NaiveSelection&>(*selectionPolicy), facilityOptions); break;
+        case PolicyKind::BALANCED: step(static_cast<BalancedSelection&>(*selectionPolicy), facilityOptions); break;
+        case PolicyKind::ECONOMY: step(static_cast<EconomySelection&>(*selectionPolicy), facilityOptions); break;
+        case PolicyKind::SUSTAINABILITY: step(static_cast<SustainabilitySelection&>(*selectionPolicy), facilityOptions); break;
+        default: step(*selectionPolicy, facilityOptions); break;
+    }
+}
 
-    if (status == PlanStatus::AVALIABLE){
-        while(static_cast<int>(underConstruction.size()) < construction_cap){
-           const FacilityType& selectedFacility = selectionPolicy->selectFacility(facilityOptions);
-           Facility* newFacility = new Facility(selectedFacility, settlement.getName());
-           underConstruction.push_back(newFacility);
+template <typename Policy>
+void Plan::step(Policy &policy, const FacilityCatalog &facilityOptions){
+    const bool timed = Metrics::countPlanStep();
+    const uint64_t begin = timed ? Metrics::now() : 0;
+
+    if (status == PlanStatus::AVALIABLE && policy.canSelect(facilityOptions)){
+        const int started = construction_cap - underConstruction.size();
+        const uint64_t selectBegin = timed ? Metrics::now() : 0;
+        selectedTypes.clear();
+        policy.selectFacilities(facilityOptions, started, selectedTypes);
+        if (timed) {
+            Metrics::record(Metrics::SELECT_FACILITY, Metrics::now() - selectBegin);
+        }
+        for (int typeIndex : selectedTypes) {
+            underConstruction.push(typeIndex, facilityOptions[typeIndex].getCost());
         }
+        Metrics::add(Metrics::FACILITIES_STARTED, started);
 
-        if(static_cast<int>(underConstruction.size()) == construction_cap){
+        if(underConstruction.size() == construction_cap){
             this->status = PlanStatus::BUSY;
         }
+    }
+
+    if (underConstruction.step() > 0) {
+        completedTypes.clear();
+        underConstruction.takeCompleted(completedTypes);
 
-     for (auto it = underConstruction.begin(); it != underConstruction.end(); ) {
-            Facility* facility = *it;
-            facility->step();
+        for (int typeIndex : completedTypes) {
+            this->addFacility(Facility(typeIndex, FacilityStatus::OPERATIONAL, 0), facilityOptions[typeIndex]);
+        }
+        Metrics::add(Metrics::FACILITIES_COMPLETED, completedTypes.size());
+        this->status = PlanStatus::AVALIABLE;
+    }
 
-            if (facility->getStatus() == FacilityStatus::OPERATIONAL) {
-       
-                this->addFacility(facility);
+    if (timed) {
+        Metrics::record(Metrics::PLAN_STEP, Metrics::now() - begin);
+    }
 
-                it = underConstruction.erase(it); 
+}
 
-               this->status = PlanStatus::AVALIABLE;
-            } 
-            else {
-                ++it; 
-                }
-        }
+/*
+The number of the next step (1 = the coming one) in which this plan does more than
+count down: it refills free slots or a building completes. Returns -1 if that never
+happens. A plan whose policy has nothing to select can't refill, so it only waits
+for its buildings.
+*/
+int Plan::stepsToNextEvent(const FacilityCatalog &facilityOptions) const{
+    return stepsToNextEvent(*selectionPolicy, facilityOptions);
+}
 
+template <typename Policy>
+int Plan::stepsToNextEvent(const Policy &policy, const FacilityCatalog &facilityOptions) const{
+    if (status == PlanStatus::AVALIABLE && policy.canSelect(facilityOptions)){
+        return 1;
     }
+    return underConstruction.nextCompletion();
+}
 
-    else{
-        for (auto it = underConstruction.begin(); it != underConstruction.end(); ) {
-            Facility* facility = *it;
-            facility->step();
+void Plan::skip(long long steps){
+    underConstruction.advance(steps);
+}
 
-            if (facility->getStatus() == FacilityStatus::OPERATIONAL) {
-       
-                this->addFacility(facility);
+/*
+Same result as numOfSteps calls to step(facilityOptions). Steps in which the plan only counts down are
+skipped in one go. With a periodic policy the plan also remembers its state each time
+it is about to refill. When a state comes back, everything from the first sighting to
+now is one period, and whole periods are applied at once: the same facilities are
+built again, the scores grow by the per-period gain, and the policy's cursor goes
+round again. Only the remainder shorter than a period is stepped.
+*/
+void Plan::advance(const FacilityCatalog &facilityOptions, int numOfSteps){
+    switch (selectionPolicy->getKind()) {
+        case PolicyKind::NAIVE: advance(static_cast<NaiveSelection&>(*selectionPolicy), facilityOptions, numOfSteps); break;
+        case PolicyKind::BALANCED: advance(static_cast<BalancedSelection&>(*selectionPolicy), facilityOptions, numOfSteps); break;
+        case PolicyKind::ECONOMY: advance(static_cast<EconomySelection&>(*selectionPolicy), facilityOptions, numOfSteps); break;
+        case PolicyKind::SUSTAINABILITY: advance(static_cast<SustainabilitySelection&>(*selectionPolicy), facilityOptions, numOfSteps); break;
+        default: advance(*selectionPolicy, facilityOptions, numOfSteps); break;
+    }
+}
 
-                it = underConstruction.erase(it);
+template <typename Policy>
+void Plan::advance(Policy &policy, const FacilityCatalog &facilityOptions, int numOfSteps){
+    struct CycleMark {
+        int elapsed;
+        size_t builtFacilities;
+        int lifeQualityScore, economyScore, environmentScore;
+    };
+    const size_t maxCycleMarks = 4096;
+    // A key lists every building in progress, so plans with bigger caps are stepped event by event.
+    const int maxCycleCap = 64;
+
+    std::unordered_map<string, CycleMark> marks;
+    bool detectCycle = numOfSteps > 1 && policy.isPeriodic() && construction_cap <= maxCycleCap;
+    int remaining = numOfSteps;
+
+    while (remaining > 0) {
+        int next = stepsToNextEvent(policy, facilityOptions);
+        if (next == -1) {
+            Metrics::add(Metrics::PLAN_STEPS, remaining);
+            return;
+        }
+        if (next > 1) {
+            int quietSteps = std::min(next - 1, remaining);
+            skip(quietSteps);
+            Metrics::add(Metrics::PLAN_STEPS, quietSteps);
+            remaining -= quietSteps;
+            continue;
+        }
 
-               this->status = PlanStatus::AVALIABLE;
-            } 
-            else {
-                ++it; 
+        if (detectCycle && status == PlanStatus::AVALIABLE) {
+            const string key = cycleKey();
+            auto seen = marks.find(key);
+            if (seen != marks.end()) {
+                const CycleMark& mark = seen->second;
+                int period = (numOfSteps - remaining) - mark.elapsed;
+                int periods = remaining / period;
+                if (periods > 0) {
+                    repeatCycle(policy, facilityOptions, mark.builtFacilities, life_quality_score - mark.lifeQualityScore,
+                                economy_score - mark.economyScore, environment_score - mark.environmentScore, periods);
+                    Metrics::add(Metrics::PLAN_STEPS, periods * period);
+                    remaining -= periods * period;
                 }
+                detectCycle = false;
+                continue;
+            }
+            if (marks.size() < maxCycleMarks) {
+                CycleMark mark = {numOfSteps - remaining, numOfFacilities, life_quality_score, economy_score, environment_score};
+                marks.emplace(key, mark);
+            }
         }
 
+        step(policy, facilityOptions);
+        remaining--;
     }
+}
 
+/*
+Everything the future of a plan with a periodic policy depends on: the policy's cursor
+and the buildings in progress, in order, with their countdowns.
+*/
+const string Plan::cycleKey() const{
+    vector<int> state;
+    state.push_back(selectionPolicy->getCursor());
+    underConstruction.forEach([&state](int typeIndex, int timeLeft) {
+        state.push_back(typeIndex);
+        state.push_back(timeLeft);
+    });
+    return string(reinterpret_cast<const char*>(&state[0]), state.size() * sizeof(int));
 }
 
-void Plan::printStatus(){
-    switch (status) {
-        case PlanStatus::AVALIABLE:
-            std::cout << "The current plan status is: AVALIABLE " << std::endl;
-            break;
-        case PlanStatus::BUSY:
-            std::cout << "The current plan status is: BUSY " << std::endl;
-            break;
-    }    
+/*
+Replays the period that started when the plan had built firstFacility buildings, times
+more times. A period starts and ends with the same buildings in progress, so it made
+exactly as many selections as it completed buildings. Replaying those selections
+moves the policy's cursor round the same loop and back to where it is now.
+*/
+template <typename Policy>
+void Plan::repeatCycle(Policy &policy, const FacilityCatalog &facilityOptions, size_t firstFacility, int lifeQualityGain, int economyGain, int environmentGain, int times){
+    const size_t periodLength = numOfFacilities - firstFacility;
+
+    if (listsFacilities) {
+        PoolVector<Facility>& built = facilities.write();
+        const size_t lastFacility = built.size();
+        built.reserve(lastFacility + periodLength * times);
+        for (int time = 0; time < times; time++) {
+            for (size_t i = firstFacility; i < lastFacility; i++) {
+                built.push_back(built[i]);
+            }
+        }
+    }
+    for (int time = 0; time < times; time++) {
+        selectedTypes.clear();
+        policy.selectFacilities(facilityOptions, static_cast<int>(periodLength), selectedTypes);
+    }
+    numOfFacilities += periodLength * times;
+
+    Metrics::add(Metrics::FACILITIES_STARTED, periodLength * times);
+    Metrics::add(Metrics::FACILITIES_COMPLETED, periodLength * times);
+
+    life_quality_score += lifeQualityGain * times;
+    economy_score += economyGain * times;
+    environment_score += environmentGain * times;
 }
 
-const vector<Facility*>& Plan::getFacilities() const{
-    return facilities;
+const PoolVector<Facility>& Plan::getFacilities() const{
+    return facilities.read();
 }
 
-const vector<Facility*>& Plan::getUnderConstruction() const{
+const ConstructionQueue& Plan::getUnderConstruction() const{
     return underConstruction;
 }
 
-void Plan::addFacility(Facility* facility) {
+void Plan::addFacility(const Facility &facility, const FacilityType &type) {
    
-    facilities.push_back(facility);
+    if (listsFacilities) {
+        facilities.write().push_back(facility);
+    }
+    numOfFacilities++;
 
-    this->environment_score += facility->getEnvironmentScore();
-    this->economy_score += facility->getEconomyScore();
-    this->life_quality_score += facility->getLifeQualityScore();
+    this->environment_score += type.getEnvironmentScore();
+    this->economy_score += type.getEconomyScore();
+    this->life_quality_score += type.getLifeQualityScore();
 }
 
-const string Plan::toString() const{
+/*
+Stops listing the built facilities and lets go of the list; their scores still count.
+For a throwaway copy that is only stepped and scored, like a branch of PolicySearch:
+it then never copies the list, which is most of a plan.
+*/
+void Plan::dropFacilities() {
+    facilities = CopyOnWrite<PoolVector<Facility>>();
+    listsFacilities = false;
+}
+
+const string Plan::toString(const FacilityCatalog &facilityOptions) const{
+    const PoolVector<Facility>& facilities = this->facilities.read();
     string result = "Plan ID: " + std::to_string(plan_id) + "\n";
     result += "Facilities:\n";
 
@@ -180,7 +348,7 @@ const string Plan::toString() const{
      else {
 
         for (size_t i = 0; i < facilities.size(); ++i) {
-            result += "  " + std::to_string(i + 1) + ". " + facilities[i]->getName() + "\n";
+            result += "  " + std::to_string(i + 1) + ". " + facilityOptions[facilities[i].getTypeIndex()].getName() + "\n";
         }
     }
     
@@ -190,20 +358,26 @@ const string Plan::toString() const{
     } 
     
     else {
-        for (size_t i = 0; i < underConstruction.size(); ++i) {
-            result += "  " + std::to_string(i + 1) + ". " + underConstruction[i]->getName() + "\n";
-        }
+        int position = 0;
+        underConstruction.forEach([&result, &position, &facilityOptions](int typeIndex, int) {
+            result += "  " + std::to_string(++position) + ". " + facilityOptions[typeIndex].getName() + "\n";
+        });
     }
 
     return result;
 }
 
-const string Plan::getSettlementName() const
+const string &Plan::getSettlementName() const
 {   
-    return settlement.getName();
+    return settlement->getName();
+}
+
+SettlementType Plan::getSettlementType() const
+{
+    return settlement->getType();
 }
 
-bool Plan::isAvailable()
+bool Plan::isAvailable() const
 {
     if(status == PlanStatus::AVALIABLE){
         return true;
@@ -213,22 +387,9 @@ bool Plan::isAvailable()
 
 
 
-const string Plan::getSelectionPolicyString() const
+const char* Plan::getSelectionPolicyName() const
 {
-    if (dynamic_cast<NaiveSelection*>(selectionPolicy)) {
-        return "nve";
-    }
-    else if (dynamic_cast<BalancedSelection*>(selectionPolicy)) {
-        return "bal";
-    }
-    else if (dynamic_cast<EconomySelection*>(selectionPolicy)) {
-        return "eco";
-    }
-    else if (dynamic_cast<SustainabilitySelection*>(selectionPolicy)) {
-        return "env";
-    }
-    
-    return "unknown";
+    return selectionPolicy->getName();
 }
 
 int Plan::getPlanId() const
@@ -236,6 +397,90 @@ int Plan::getPlanId() const
     return plan_id;
 }
 
+int Plan::getConstructionCap() const
+{
+    return construction_cap;
+}
+
 SelectionPolicy* Plan::getSelectionPolicy() const {
     return selectionPolicy;
+}
+
+// stepsBehind steps in which the plan had nothing due are counted as done (see Simulation::advance).
+void Plan::save(BinaryWriter &writer, long long stepsBehind) const {
+    writer.writeSignedVarint(plan_id);
+    writer.writeString(settlement->getName());
+    writer.writeByte(static_cast<uint8_t>(settlement->getType()));
+    writer.writeSignedVarint(construction_cap);
+    writer.writeByte(static_cast<uint8_t>(status));
+    writer.writeSignedVarint(life_quality_score);
+    writer.writeSignedVarint(economy_score);
+    writer.writeSignedVarint(environment_score);
+    selectionPolicy->save(writer);
+
+    // Built facilities are always operational, so only their catalog indices are kept.
+    const PoolVector<Facility>& built = facilities.read();
+    vector<int> typeIndices;
+    typeIndices.reserve(built.size());
+    for (const Facility& facility : built) {
+        typeIndices.push_back(facility.getTypeIndex());
+    }
+    writer.writeVarint(typeIndices.size());
+    if (!typeIndices.empty()) {
+        writer.writeInts(&typeIndices[0], typeIndices.size());
+    }
+    underConstruction.save(writer, stepsBehind);
+}
+
+/*
+findSettlement looks up the loaded settlements by name. A plan takes the cap of the
+settlement it was made for, so a cap that doesn't match it is corrupt; that also keeps
+it within the settlement's bound.
+*/
+Plan Plan::load(BinaryReader &reader, int numOfFacilityOptions,
+                const std::function<std::shared_ptr<const Settlement>(const string&)> &findSettlement) {
+    int planId = reader.readInt();
+    string settlementName = reader.readString();
+    uint8_t settlementType = reader.readByte();
+    int constructionCap = reader.readInt();
+    uint8_t status = reader.readByte();
+    int lifeQualityScore = reader.readInt();
+    int economyScore = reader.readInt();
+    int environmentScore = reader.readInt();
+    if (settlementType > static_cast<uint8_t>(SettlementType::METROPOLIS) || status > static_cast<uint8_t>(PlanStatus::BUSY)) {
+        throw std::runtime_error("Corrupt plan in snapshot");
+    }
+
+    std::shared_ptr<const Settlement> settlement = findSettlement(settlementName);
+    if (!settlement || settlement->getType() != static_cast<SettlementType>(settlementType) || settlement->getConstructionCap() != constructionCap) {
+        throw std::runtime_error("Corrupt plan in snapshot");
+    }
+
+    Plan plan(planId, settlement, SelectionPolicy::load(reader, numOfFacilityOptions));
+    plan.status = static_cast<PlanStatus>(status);
+    plan.life_quality_score = lifeQualityScore;
+    plan.economy_score = economyScore;
+    plan.environment_score = environmentScore;
+
+    vector<int> typeIndices(reader.readCount());
+    if (!typeIndices.empty()) {
+        reader.readInts(&typeIndices[0], typeIndices.size());
+    }
+    PoolVector<Facility>& built = plan.facilities.write();
+    built.reserve(typeIndices.size());
+    plan.numOfFacilities = typeIndices.size();
+    for (int typeIndex : typeIndices) {
+        if (typeIndex < 0 || typeIndex >= numOfFacilityOptions) {
+            throw std::runtime_error("Corrupt plan in snapshot");
+        }
+        built.emplace_back(typeIndex, FacilityStatus::OPERATIONAL, 0);
+    }
+
+    plan.underConstruction.load(reader);
+    plan.underConstruction.forEach([numOfFacilityOptions](int typeIndex, int) {
+        if (typeIndex < 0 || typeIndex >= numOfFacilityOptions) {
+            throw std::runtime_error("Corrupt plan in snapshot");
+        }
+    });
+    return plan;
 }
\ No newline at end of file
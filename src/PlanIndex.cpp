@@ -0,0 +1,224 @@
+#include "PlanIndex.h"
+#include <algorithm>
+
+static const char *METRIC_NAMES[PlanIndex::NUM_OF_METRICS] = {"lq", "eco", "env"};
+static const char *SCORE_NAMES[PlanIndex::NUM_OF_METRICS] = {"LifeQualityScore", "EconomyScore", "EnvironmentScore"};
+static const char *GROUPING_NAMES[PlanIndex::NUM_OF_GROUPINGS] = {"settlement", "type", "policy"};
+static const char *TYPE_NAMES[] = {"VILLAGE", "CITY", "METROPOLIS"};
+static const int NUM_OF_TYPES = 3;
+
+PlanIndex::Group::Group(const string &name, int numOfPlans, long long total)
+    : name(name), numOfPlans(numOfPlans), total(total) {}
+
+PlanIndex::Totals::Totals() : numOfPlans(0), totals() {}
+
+// The built-in policies' groups are numbered by their PolicyKind.
+PlanIndex::Names::Names() : settlementNames(), settlementGroups(), policyNames(), policyGroups() {
+    for (int policy = 0; policy < static_cast<int>(PolicyKind::CUSTOM); policy++) {
+        policyGroups.insert(std::make_pair(string(SelectionPolicy::getPolicyName(policy)), policy));
+        policyNames.push_back(SelectionPolicy::getPolicyName(policy));
+    }
+}
+
+PlanIndex::PlanIndex() : entries(), changedPlans(), boards(), totals(), names() {
+    totals[BY_TYPE].write().resize(NUM_OF_TYPES);
+    totals[BY_POLICY].write().resize(names.read().policyNames.size());
+}
+
+bool PlanIndex::parseMetric(const string &name, Metric &metric) {
+    for (int i = 0; i < NUM_OF_METRICS; i++) {
+        if (name == METRIC_NAMES[i]) {
+            metric = static_cast<Metric>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PlanIndex::parseGrouping(const string &name, Grouping &grouping) {
+    for (int i = 0; i < NUM_OF_GROUPINGS; i++) {
+        if (name == GROUPING_NAMES[i]) {
+            grouping = static_cast<Grouping>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* PlanIndex::getScoreName(Metric metric) {
+    return SCORE_NAMES[metric];
+}
+
+int PlanIndex::getScore(const Plan &plan, Metric metric) {
+    switch (metric) {
+        case LIFE_QUALITY: return plan.getlifeQualityScore();
+        case ECONOMY: return plan.getEconomyScore();
+        default: return plan.getEnvironmentScore();
+    }
+}
+
+/*
+Takes the plan that was just appended to the simulation; its scores are read by the
+next refresh. Its settlement and type never change, so they are looked up once, here.
+*/
+void PlanIndex::addPlan(const Plan &plan) {
+    Entry entry = Entry();
+    std::unordered_map<string, int>::const_iterator group = names.read().settlementGroups.find(plan.getSettlementName());
+    if (group == names.read().settlementGroups.end()) {
+        Names& added = names.write();
+        group = added.settlementGroups.insert(std::make_pair(plan.getSettlementName(), static_cast<int>(added.settlementNames.size()))).first;
+        added.settlementNames.push_back(plan.getSettlementName());
+        totals[BY_SETTLEMENT].write().push_back(Totals());
+    }
+    entry.groups[BY_SETTLEMENT] = group->second;
+    entry.groups[BY_TYPE] = static_cast<int>(plan.getSettlementType());
+    entry.changed = true;
+    entry.listed = false;
+
+    changedPlans.push_back(static_cast<int>(entries.size()));
+    entries.emplace_back(entry);
+}
+
+// The plan may be changed in any way; it is re-read by the next refresh.
+void PlanIndex::markChanged(int planId) {
+    if (!entries[planId].changed) {
+        entries.write(planId).changed = true;
+        changedPlans.push_back(planId);
+    }
+}
+
+// Reads the marked plans again and merges their old and new keys into the sets, like apply.
+void PlanIndex::refresh(const SegmentedVector<CopyOnWrite<Plan>> &plans) {
+    if (changedPlans.empty()) {
+        return;
+    }
+    vector<Key> removed[NUM_OF_METRICS];
+    vector<Key> added[NUM_OF_METRICS];
+    for (int planId : changedPlans) {
+        Entry& entry = entries.write(planId);
+        if (entry.listed) {
+            count(entry, -1);
+            for (int metric = 0; metric < NUM_OF_METRICS; metric++) {
+                removed[metric].push_back(Key(entry.scores[metric], -planId));
+            }
+        }
+        read(entry, plans[planId].read());
+        count(entry, 1);
+        for (int metric = 0; metric < NUM_OF_METRICS; metric++) {
+            added[metric].push_back(Key(entry.scores[metric], -planId));
+        }
+    }
+    changedPlans.clear();
+
+    for (int metric = 0; metric < NUM_OF_METRICS; metric++) {
+        std::sort(removed[metric].begin(), removed[metric].end());
+        std::sort(added[metric].begin(), added[metric].end());
+        boards[metric].update(removed[metric], added[metric]);
+    }
+}
+
+/*
+Applies the changes of one step. Each metric's old and new keys are sorted and
+merged into its set in one pass, and the totals move by the difference.
+*/
+void PlanIndex::apply(const vector<Change> &changes) {
+    if (changes.empty()) {
+        return;
+    }
+    vector<Key> removed;
+    vector<Key> added;
+    removed.reserve(changes.size());
+    added.reserve(changes.size());
+    for (int metric = 0; metric < NUM_OF_METRICS; metric++) {
+        removed.clear();
+        added.clear();
+        for (const Change& change : changes) {
+            if (change.before[metric] != change.after[metric]) {
+                removed.push_back(Key(change.before[metric], -change.planId));
+                added.push_back(Key(change.after[metric], -change.planId));
+            }
+        }
+        std::sort(removed.begin(), removed.end());
+        std::sort(added.begin(), added.end());
+        boards[metric].update(removed, added);
+    }
+
+    vector<Totals>* sums[NUM_OF_GROUPINGS];
+    for (int grouping = 0; grouping < NUM_OF_GROUPINGS; grouping++) {
+        sums[grouping] = &totals[grouping].write();
+    }
+    for (const Change& change : changes) {
+        Entry& entry = entries.write(change.planId);
+        for (int grouping = 0; grouping < NUM_OF_GROUPINGS; grouping++) {
+            Totals& group = (*sums[grouping])[entry.groups[grouping]];
+            for (int metric = 0; metric < NUM_OF_METRICS; metric++) {
+                group.totals[metric] += change.after[metric] - change.before[metric];
+            }
+        }
+        for (int metric = 0; metric < NUM_OF_METRICS; metric++) {
+            entry.scores[metric] = change.after[metric];
+        }
+    }
+}
+
+vector<int> PlanIndex::top(Metric metric, int count) const {
+    vector<int> planIds;
+    if (count <= 0) {
+        return planIds;
+    }
+    const vector<Key> keys = boards[metric].last(count);
+    for (const Key& key : keys) {
+        planIds.push_back(-key.second);
+    }
+    return planIds;
+}
+
+// Groups without plans are left out.
+vector<PlanIndex::Group> PlanIndex::aggregate(Metric metric, Grouping grouping) const {
+    vector<Group> groups;
+    const vector<Totals>& sums = totals[grouping].read();
+    for (size_t i = 0; i < sums.size(); i++) {
+        if (sums[i].numOfPlans == 0) {
+            continue;
+        }
+        const char *name = grouping == BY_SETTLEMENT ? names.read().settlementNames[i].c_str()
+                         : grouping == BY_TYPE ? TYPE_NAMES[i] : names.read().policyNames[i].c_str();
+        groups.push_back(Group(name, sums[i].numOfPlans, sums[i].totals[metric]));
+    }
+    return groups;
+}
+
+void PlanIndex::read(Entry &entry, const Plan &plan) {
+    for (int metric = 0; metric < NUM_OF_METRICS; metric++) {
+        entry.scores[metric] = getScore(plan, static_cast<Metric>(metric));
+    }
+    entry.groups[BY_POLICY] = policyGroup(*plan.getSelectionPolicy());
+    entry.changed = false;
+    entry.listed = true;
+}
+
+// Custom policies are looked up by name and get a group the first time they are seen.
+int PlanIndex::policyGroup(const SelectionPolicy &policy) {
+    if (policy.getKind() != PolicyKind::CUSTOM) {
+        return static_cast<int>(policy.getKind());
+    }
+    std::unordered_map<string, int>::const_iterator group = names.read().policyGroups.find(policy.getName());
+    if (group == names.read().policyGroups.end()) {
+        Names& added = names.write();
+        group = added.policyGroups.insert(std::make_pair(string(policy.getName()), static_cast<int>(added.policyNames.size()))).first;
+        added.policyNames.push_back(policy.getName());
+        totals[BY_POLICY].write().push_back(Totals());
+    }
+    return group->second;
+}
+
+// Adds the entry to its groups' totals (sign 1) or takes it out of them (sign -1).
+void PlanIndex::count(const Entry &entry, int sign) {
+    for (int grouping = 0; grouping < NUM_OF_GROUPINGS; grouping++) {
+        Totals& sums = totals[grouping].write()[entry.groups[grouping]];
+        sums.numOfPlans += sign;
+        for (int metric = 0; metric < NUM_OF_METRICS; metric++) {
+            sums.totals[metric] += sign * static_cast<long long>(entry.scores[metric]);
+        }
+    }
+}
@@ -0,0 +1,187 @@
+#include "PolicySearch.h"
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include "Metrics.h"
+#include "SelectionPolicy.h"
+#include "ThreadPool.h"
+
+PolicySearch::Result::Result()
+    : schedule(), segmentLength(0), numOfSchedules(0), lifeQualityScore(0), economyScore(0), environmentScore(0) {}
+
+PolicySearch::Candidate::Candidate()
+    : found(false), primary(0), secondary(0), switches(0), schedule(0), lifeQualityScore(0), economyScore(0), environmentScore(0) {}
+
+// Higher objective first, then higher total score, then fewer switches, then the earlier schedule.
+bool PolicySearch::Candidate::isBetterThan(const Candidate &other) const {
+    if (!other.found) {
+        return found;
+    }
+    if (!found) {
+        return false;
+    }
+    if (primary != other.primary) {
+        return primary > other.primary;
+    }
+    if (secondary != other.secondary) {
+        return secondary > other.secondary;
+    }
+    if (switches != other.switches) {
+        return switches < other.switches;
+    }
+    return schedule < other.schedule;
+}
+
+PolicySearch::PolicySearch(const FacilityCatalog &facilityOptions, int horizon, Objective objective)
+    : facilityOptions(facilityOptions), horizon(horizon), objective(objective), numOfSegments(0), segmentLength(0) {
+    int segments = std::min(horizon, static_cast<int>(MAX_SEGMENTS));
+    segmentLength = (horizon + segments - 1) / segments;
+    numOfSegments = (horizon + segmentLength - 1) / segmentLength;
+}
+
+bool PolicySearch::parseObjective(const string &name, Objective &objective) {
+    if (name == "lq") {
+        objective = Objective::LIFE_QUALITY;
+    } else if (name == "eco") {
+        objective = Objective::ECONOMY;
+    } else if (name == "env") {
+        objective = Objective::ENVIRONMENT;
+    } else if (name == "min") {
+        objective = Objective::MIN_SCORE;
+    } else if (name == "balance") {
+        objective = Objective::BALANCE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* PolicySearch::getPolicyName(int policy) {
+    return SelectionPolicy::getPolicyName(policy);
+}
+
+int PolicySearch::segmentSteps(int segment) const {
+    return std::min(segmentLength, horizon - segment * segmentLength);
+}
+
+// Returns whether the branch had to switch policy.
+bool PolicySearch::advanceBranch(Plan &branch, int segment, int policy) const {
+    bool switched = static_cast<int>(branch.getSelectionPolicy()->getKind()) != policy;
+    if (switched) {
+        branch.setSelectionPolicy(SelectionPolicy::create(policy, branch.getlifeQualityScore(), branch.getEconomyScore(), branch.getEnvironmentScore()));
+    }
+    branch.advance(facilityOptions, segmentSteps(segment));
+    return switched;
+}
+
+PolicySearch::Candidate PolicySearch::evaluate(const Plan &leaf, int schedule, int switches) const {
+    Candidate candidate;
+    candidate.found = true;
+    candidate.switches = switches;
+    candidate.schedule = schedule;
+    candidate.lifeQualityScore = leaf.getlifeQualityScore();
+    candidate.economyScore = leaf.getEconomyScore();
+    candidate.environmentScore = leaf.getEnvironmentScore();
+
+    long long lifeQuality = candidate.lifeQualityScore;
+    long long economy = candidate.economyScore;
+    long long environment = candidate.environmentScore;
+    long long lowest = std::min(lifeQuality, std::min(economy, environment));
+    long long highest = std::max(lifeQuality, std::max(economy, environment));
+    candidate.secondary = lifeQuality + economy + environment;
+    switch (objective) {
+        case Objective::LIFE_QUALITY: candidate.primary = lifeQuality; break;
+        case Objective::ECONOMY: candidate.primary = economy; break;
+        case Objective::ENVIRONMENT: candidate.primary = environment; break;
+        case Objective::MIN_SCORE: candidate.primary = lowest; break;
+        case Objective::BALANCE: candidate.primary = lowest - highest; break;
+    }
+    return candidate;
+}
+
+void PolicySearch::explore(const Plan &node, int segment, int schedule, int switches, Candidate &best) const {
+    if (segment == numOfSegments) {
+        Candidate candidate = evaluate(node, schedule, switches);
+        if (candidate.isBetterThan(best)) {
+            best = candidate;
+        }
+        return;
+    }
+    for (int policy = 0; policy < NUM_OF_POLICIES; policy++) {
+        Plan branch(node);
+        bool switched = advanceBranch(branch, segment, policy);
+        explore(branch, segment + 1, schedule * NUM_OF_POLICIES + policy, switches + (switched ? 1 : 0), best);
+    }
+}
+
+PolicySearch::Result PolicySearch::search(const Plan &plan, const FacilityCatalog &facilityOptions, int horizon,
+                                          Objective objective, ThreadPool *pool) {
+    // The branches are what-ifs, so their steps and selections stay out of the stats.
+    Metrics::Pause pause;
+    PolicySearch search(facilityOptions, horizon, objective);
+
+    // Expand the top of the tree until there are a few subtrees per thread.
+    const size_t numOfTasks = pool == nullptr ? 1 : static_cast<size_t>(pool->getNumOfThreads()) * 4;
+    vector<std::unique_ptr<Plan>> frontier;
+    vector<int> prefixes(1, 0);
+    vector<int> switches(1, 0);
+    frontier.emplace_back(new Plan(plan));
+    frontier.back()->dropFacilities();
+    int depth = 0;
+    while (frontier.size() < numOfTasks && depth < search.numOfSegments) {
+        vector<std::unique_ptr<Plan>> next;
+        vector<int> nextPrefixes;
+        vector<int> nextSwitches;
+        for (size_t i = 0; i < frontier.size(); i++) {
+            for (int policy = 0; policy < NUM_OF_POLICIES; policy++) {
+                next.emplace_back(new Plan(*frontier[i]));
+                bool switched = search.advanceBranch(*next.back(), depth, policy);
+                nextPrefixes.push_back(prefixes[i] * NUM_OF_POLICIES + policy);
+                nextSwitches.push_back(switches[i] + (switched ? 1 : 0));
+            }
+        }
+        frontier.swap(next);
+        prefixes.swap(nextPrefixes);
+        switches.swap(nextSwitches);
+        depth++;
+    }
+
+    vector<Candidate> bests(frontier.size());
+    if (pool != nullptr && frontier.size() > 1) {
+        vector<std::function<void()>> tasks;
+        for (size_t i = 0; i < frontier.size(); i++) {
+            tasks.push_back([&search, &frontier, &prefixes, &switches, &bests, depth, i] {
+                Metrics::Pause pause;
+                search.explore(*frontier[i], depth, prefixes[i], switches[i], bests[i]);
+            });
+        }
+        pool->run(tasks);
+    } else {
+        for (size_t i = 0; i < frontier.size(); i++) {
+            search.explore(*frontier[i], depth, prefixes[i], switches[i], bests[i]);
+        }
+    }
+
+    Candidate best;
+    for (const Candidate &candidate : bests) {
+        if (candidate.isBetterThan(best)) {
+            best = candidate;
+        }
+    }
+
+    Result result;
+    result.segmentLength = search.segmentLength;
+    result.numOfSchedules = 1;
+    for (int segment = 0; segment < search.numOfSegments; segment++) {
+        result.numOfSchedules *= NUM_OF_POLICIES;
+    }
+    result.schedule.resize(search.numOfSegments);
+    for (int segment = search.numOfSegments - 1, schedule = best.schedule; segment >= 0; segment--) {
+        result.schedule[segment] = schedule % NUM_OF_POLICIES;
+        schedule /= NUM_OF_POLICIES;
+    }
+    result.lifeQualityScore = best.lifeQualityScore;
+    result.economyScore = best.economyScore;
+    result.environmentScore = best.environmentScore;
+    return result;
+}
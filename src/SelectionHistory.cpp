@@ -0,0 +1,80 @@
+#include "SelectionHistory.h"
+#include <algorithm>
+#include <stdexcept>
+
+SelectionHistory::SelectionHistory() : segments(), count(0) {}
+
+void SelectionHistory::append(int typeIndex) {
+    if (segments.empty() || static_cast<int>(segments.back()->size()) == SEGMENT_SIZE) {
+        segments.push_back(std::allocate_shared<Segment>(PoolAllocator<Segment>()));
+        segments.back()->reserve(SEGMENT_SIZE);
+    }
+    else if (segments.back().use_count() > 1) {
+        std::shared_ptr<Segment> copy = std::allocate_shared<Segment>(PoolAllocator<Segment>(), *segments.back());
+        copy->reserve(SEGMENT_SIZE);
+        segments.back() = copy;
+    }
+    segments.back()->push_back(typeIndex);
+    count++;
+}
+
+/*
+Appends a batch of selections, a segment's worth at a time, making the same segments
+as appending them one by one.
+*/
+void SelectionHistory::append(const int *typeIndices, int numOfSelections) {
+    while (numOfSelections > 0) {
+        append(*typeIndices);
+        int room = SEGMENT_SIZE - static_cast<int>(segments.back()->size());
+        int length = std::min(room, numOfSelections - 1);
+        segments.back()->insert(segments.back()->end(), typeIndices + 1, typeIndices + 1 + length);
+        count += length;
+        typeIndices += length + 1;
+        numOfSelections -= length + 1;
+    }
+}
+
+int SelectionHistory::size() const {
+    return count;
+}
+
+int SelectionHistory::get(int index) const {
+    return (*segments[index / SEGMENT_SIZE])[index % SEGMENT_SIZE];
+}
+
+const string SelectionHistory::toString(const FacilityCatalog &facilitiesOptions) const {
+    string result = "Built Facilities list:";
+    for (int i = 0; i < count; i++) {
+        result += "\n" + std::to_string(i + 1) + ". " + facilitiesOptions[get(i)].getName();
+    }
+    return result;
+}
+
+void SelectionHistory::save(BinaryWriter &writer) const {
+    writer.writeVarint(count);
+    for (const std::shared_ptr<Segment>& segment : segments) {
+        writer.writeInts(&(*segment)[0], segment->size());
+    }
+}
+
+void SelectionHistory::load(BinaryReader &reader, int numOfFacilityOptions) {
+    segments.clear();
+    count = 0;
+    size_t numOfSelections = reader.readCount();
+    while (count < static_cast<int>(numOfSelections)) {
+        int length = static_cast<int>(numOfSelections) - count;
+        if (length > SEGMENT_SIZE) {
+            length = SEGMENT_SIZE;
+        }
+        std::shared_ptr<Segment> segment = std::allocate_shared<Segment>(PoolAllocator<Segment>(), length);
+        reader.readInts(&(*segment)[0], length);
+        for (int typeIndex : *segment) {
+            if (typeIndex < 0 || typeIndex >= numOfFacilityOptions) {
+                throw std::runtime_error("Corrupt selection history in snapshot");
+            }
+        }
+        segment->reserve(SEGMENT_SIZE);
+        segments.push_back(segment);
+        count += length;
+    }
+}
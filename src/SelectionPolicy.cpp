@@ -1,239 +1,344 @@
 #include "SelectionPolicy.h"
+#include "MemoryPool.h"
 #include <vector>
 #include <iostream>
 #include <cstdlib>
 using std::vector;
 #include <limits>
 #include <algorithm>
+#include <stdexcept>
 
+struct RegisteredPolicy {
+    string name;
+    SelectionPolicy::Factory factory;
+};
 
-NaiveSelection::NaiveSelection():lastSelectedIndex(-1), numberOfFacilities(0), builtFacilitiesList("Built Facilities list:"){}
-
-const FacilityType& NaiveSelection::selectFacility(const vector<FacilityType>& facilitiesOptions){
-    numberOfFacilities++;
+static SelectionPolicy* createNaive(int, int, int) {
+    return new NaiveSelection();
+}
 
-    if((lastSelectedIndex + 1) < static_cast<int>(facilitiesOptions.size())){
-       const FacilityType& output_option1 = facilitiesOptions[lastSelectedIndex + 1];
-       lastSelectedIndex++;
-       builtFacilitiesList += "\n" + std::to_string(numberOfFacilities) + ". "  + output_option1.getName(); 
+static SelectionPolicy* createBalanced(int lifeQualityScore, int economyScore, int environmentScore) {
+    return new BalancedSelection(lifeQualityScore, economyScore, environmentScore);
+}
 
-       return output_option1;
-    }
-    else{
-         const FacilityType& output_option2 = facilitiesOptions[0];
-         lastSelectedIndex = 0;
-         builtFacilitiesList += "\n" +std::to_string(numberOfFacilities) + ". " + output_option2.getName(); 
+static SelectionPolicy* createEconomy(int, int, int) {
+    return new EconomySelection();
+}
 
-         return output_option2;
-    }
+static SelectionPolicy* createSustainability(int, int, int) {
+    return new SustainabilitySelection();
+}
 
+// The built-in policies come first, in PolicyKind order. They are loaded by their kind, not through the registry.
+static vector<RegisteredPolicy>& registry() {
+    static vector<RegisteredPolicy> policies = {
+        {"nve", {createNaive, nullptr}},
+        {"bal", {createBalanced, nullptr}},
+        {"eco", {createEconomy, nullptr}},
+        {"env", {createSustainability, nullptr}},
+    };
+    return policies;
+}
 
+// Policies come from the pool of the simulation whose plan they are created for.
+void* SelectionPolicy::operator new(size_t size) {
+    return MemoryPool::allocateObject(size);
 }
 
-const string  NaiveSelection::toString() const{
-    return builtFacilitiesList;
+void SelectionPolicy::operator delete(void* pointer, size_t size) {
+    MemoryPool::deallocateObject(pointer, size);
 }
 
-NaiveSelection* NaiveSelection::clone() const{
-    NaiveSelection* clone = new NaiveSelection();
-    clone->lastSelectedIndex = this->lastSelectedIndex;
-    clone->numberOfFacilities = this->numberOfFacilities;
-    clone->builtFacilitiesList = this->builtFacilitiesList;
+/*
+A periodic policy picks its next facility from a cursor into facilitiesOptions and
+nothing else, so once a plan comes back to the same cursor with the same buildings
+in progress it repeats itself. getCursor() exposes that cursor.
+*/
+SelectionPolicy::SelectionPolicy(PolicyKind kind) : kind(kind) {}
 
-    return clone;
+PolicyKind SelectionPolicy::getKind() const{
+    return kind;
 }
 
-BalancedSelection::BalancedSelection(int LifeQualityScore, int EconomyScore, int EnvironmentScore):
-LifeQualityScore(LifeQualityScore),
-EconomyScore(EconomyScore),
-EnvironmentScore(EnvironmentScore),
-numberOfFacilities(0),
-builtFacilitiesList("Built Facilities list:")
-{}
-
-const FacilityType& BalancedSelection:: selectFacility(const vector<FacilityType>& facilitiesOptions){
-    numberOfFacilities++;
-   
-    const FacilityType* current = &facilitiesOptions[0];
-    int firstadd_lifeq_score  = LifeQualityScore + current->getLifeQualityScore();
-    int firstadd_eco_score = EconomyScore + current->getEconomyScore();
-    int firstadd_envo_score = EnvironmentScore + current->getEnvironmentScore();
-
-    int a = abs(firstadd_lifeq_score - firstadd_eco_score);
-    int b = abs(firstadd_lifeq_score - firstadd_envo_score);
-    int c = abs(firstadd_eco_score - firstadd_envo_score);
-    
-    int minimalDistance = std::max({a, b, c});
-    
-    if (minimalDistance == 0){
-        return *current;
+/*
+Appends the next count selections to selected, as catalog indices. This fallback
+makes them one call at a time; the built-in policies batch them.
+*/
+void SelectionPolicy::selectFacilities(const FacilityCatalog& facilitiesOptions, int count, vector<int> &selected){
+    for (int i = 0; i < count; i++) {
+        selected.push_back(static_cast<int>(&selectFacility(facilitiesOptions) - &facilitiesOptions[0]));
     }
+}
 
-    for (const FacilityType& facility : facilitiesOptions) {
-        int secondAdd_lifeq_score  = LifeQualityScore + facility.getLifeQualityScore();
-        int SecondAdd_eco_score = EconomyScore + facility.getEconomyScore();
-        int SecondAdd_envo_score = EnvironmentScore + facility.getEnvironmentScore();
-
-        int x = abs( secondAdd_lifeq_score -  SecondAdd_eco_score);
-        int y = abs( secondAdd_lifeq_score -  SecondAdd_envo_score);
-        int z = abs( SecondAdd_eco_score -  SecondAdd_envo_score);
-       
+bool SelectionPolicy::isPeriodic() const{
+    return false;
+}
 
-        int currentdistance = std::max({x, y, z});
+int SelectionPolicy::getCursor() const{
+    return -1;
+}
 
+/*
+Whether selectFacility() has anything to return. A plan leaves its free slots empty
+while it is false.
+*/
+bool SelectionPolicy::canSelect(const FacilityCatalog& facilitiesOptions) const{
+    return !facilitiesOptions.empty();
+}
 
-        if (currentdistance == 0){
-            return facility;
+SelectionPolicy* SelectionPolicy::load(BinaryReader &reader, int numOfFacilityOptions){
+    switch (static_cast<PolicyKind>(reader.readByte())) {
+        case PolicyKind::NAIVE: return NaiveSelection::load(reader, numOfFacilityOptions);
+        case PolicyKind::BALANCED: return BalancedSelection::load(reader);
+        case PolicyKind::ECONOMY: return EconomySelection::load(reader, numOfFacilityOptions);
+        case PolicyKind::SUSTAINABILITY: return SustainabilitySelection::load(reader, numOfFacilityOptions);
+        case PolicyKind::CUSTOM: {
+            int policy = findPolicy(reader.readString());
+            if (policy == -1 || registry()[policy].factory.load == nullptr) {
+                throw std::runtime_error("Unknown selection policy in snapshot");
+            }
+            return registry()[policy].factory.load(reader, numOfFacilityOptions);
         }
+        default: throw std::runtime_error("Unknown selection policy in snapshot");
+    }
+}
 
-        if(minimalDistance > currentdistance){
-            minimalDistance = currentdistance;
-            current = &facility;
-        } 
+// Returns the policy's number, or -1 if the name is taken.
+int SelectionPolicy::registerPolicy(const string &name, const Factory &factory){
+    if (findPolicy(name) != -1) {
+        return -1;
+    }
+    registry().push_back(RegisteredPolicy{name, factory});
+    return getNumOfPolicies() - 1;
+}
 
+// The policy's number, which for a built-in one is its PolicyKind, or -1 if there is none by that name.
+int SelectionPolicy::findPolicy(const string &name){
+    const vector<RegisteredPolicy>& policies = registry();
+    for (size_t i = 0; i < policies.size(); i++) {
+        if (policies[i].name == name) {
+            return static_cast<int>(i);
+        }
     }
-    LifeQualityScore += current->getLifeQualityScore();
-    EnvironmentScore += current->getEnvironmentScore();
-    EconomyScore += current->getEconomyScore();
+    return -1;
+}
+
+int SelectionPolicy::getNumOfPolicies(){
+    return static_cast<int>(registry().size());
+}
+
+const char* SelectionPolicy::getPolicyName(int policy){
+    return registry()[policy].name.c_str();
+}
 
-    return *current;
+SelectionPolicy* SelectionPolicy::create(int policy, int lifeQualityScore, int economyScore, int environmentScore){
+    return registry()[policy].factory.create(lifeQualityScore, economyScore, environmentScore);
 }
 
+// Every policy's save() starts with this; a custom policy is followed by its name.
+void SelectionPolicy::saveKind(BinaryWriter &writer) const{
+    writer.writeByte(static_cast<uint8_t>(kind));
+    if (kind == PolicyKind::CUSTOM) {
+        writer.writeString(getName());
+    }
+}
 
-const string BalancedSelection:: toString() const{
-    return builtFacilitiesList;
+NaiveSelection::NaiveSelection():SelectionPolicy(PolicyKind::NAIVE), lastSelectedIndex(-1), numberOfFacilities(0), builtFacilities(){}
 
+const char* NaiveSelection::getName() const{
+    return "nve";
 }
 
-BalancedSelection* BalancedSelection::clone() const{
-    BalancedSelection* clone = new BalancedSelection(LifeQualityScore,EconomyScore,EnvironmentScore);
-    clone->builtFacilitiesList = this->builtFacilitiesList;
+const string  NaiveSelection::toString(const FacilityCatalog& facilitiesOptions) const{
+    return builtFacilities.toString(facilitiesOptions);
+}
+
+NaiveSelection* NaiveSelection::clone() const{
+    NaiveSelection* clone = new NaiveSelection();
+    clone->lastSelectedIndex = this->lastSelectedIndex;
     clone->numberOfFacilities = this->numberOfFacilities;
-    
+    clone->builtFacilities = this->builtFacilities;
+
     return clone;
 }
 
+bool NaiveSelection::isPeriodic() const{
+    return true;
+}
 
-EconomySelection::EconomySelection():lastSelectedIndex(-1),numberOfFacilities(0),builtFacilitiesList("Built Facilities list:"){}
+int NaiveSelection::getCursor() const{
+    return lastSelectedIndex;
+}
 
-const FacilityType& EconomySelection::selectFacility(const vector<FacilityType>& facilitiesOptions){
+void NaiveSelection::save(BinaryWriter &writer) const{
+    saveKind(writer);
+    writer.writeSignedVarint(lastSelectedIndex);
+    writer.writeSignedVarint(numberOfFacilities);
+    builtFacilities.save(writer);
+}
 
-    numberOfFacilities++;
-    int i;
-    bool inside_start = false;
+NaiveSelection* NaiveSelection::load(BinaryReader &reader, int numOfFacilityOptions){
+    int lastSelectedIndex = reader.readInt();
+    int numberOfFacilities = reader.readInt();
+    if (lastSelectedIndex < -1 || lastSelectedIndex >= numOfFacilityOptions) {
+        throw std::runtime_error("Corrupt selection policy in snapshot");
+    }
+    SelectionHistory builtFacilities;
+    builtFacilities.load(reader, numOfFacilityOptions);
+
+    NaiveSelection* policy = new NaiveSelection();
+    policy->lastSelectedIndex = lastSelectedIndex;
+    policy->numberOfFacilities = numberOfFacilities;
+    policy->builtFacilities = builtFacilities;
+    return policy;
+}
 
+BalancedSelection::BalancedSelection(int LifeQualityScore, int EconomyScore, int EnvironmentScore):
+SelectionPolicy(PolicyKind::BALANCED),
+LifeQualityScore(LifeQualityScore),
+EconomyScore(EconomyScore),
+EnvironmentScore(EnvironmentScore),
+numberOfFacilities(0)
+{}
 
-    if(lastSelectedIndex  ==-1 || lastSelectedIndex + 1 == static_cast<int>(facilitiesOptions.size())){
-        i = 0; 
-    }
+const char* BalancedSelection::getName() const{
+    return "bal";
+}
 
-    else{
-        i = lastSelectedIndex + 1;
-        inside_start = true;
-    }
+const string BalancedSelection:: toString(const FacilityCatalog&) const{
+    return "Built Facilities list:";
+
+}
 
+BalancedSelection* BalancedSelection::clone() const{
+    BalancedSelection* clone = new BalancedSelection(LifeQualityScore,EconomyScore,EnvironmentScore);
+    clone->numberOfFacilities = this->numberOfFacilities;
     
-    const FacilityType* current = & facilitiesOptions[i];
+    return clone;
+}
 
-        while(current->getCategory()!= FacilityCategory::ECONOMY){
-            if(!inside_start){
-                i++;
-                current = &facilitiesOptions[i];
-            }
-            else{
-                if(i == (static_cast<int>(facilitiesOptions.size()) - 1)){
-                    i = 0;
-                }
-                else{
-                    i++;
-                }
-                current = &facilitiesOptions[i];
 
-            }
+void BalancedSelection::save(BinaryWriter &writer) const{
+    saveKind(writer);
+    writer.writeSignedVarint(LifeQualityScore);
+    writer.writeSignedVarint(EconomyScore);
+    writer.writeSignedVarint(EnvironmentScore);
+    writer.writeSignedVarint(numberOfFacilities);
+}
 
+BalancedSelection* BalancedSelection::load(BinaryReader &reader){
+    int lifeQualityScore = reader.readInt();
+    int economyScore = reader.readInt();
+    int environmentScore = reader.readInt();
+    int numberOfFacilities = reader.readInt();
 
-    }
+    BalancedSelection* policy = new BalancedSelection(lifeQualityScore, economyScore, environmentScore);
+    policy->numberOfFacilities = numberOfFacilities;
+    return policy;
+}
 
-    lastSelectedIndex = i;
 
-    builtFacilitiesList += "\n" + std::to_string(numberOfFacilities) + ". "  + current->getName();
-    return *current;
+EconomySelection::EconomySelection():SelectionPolicy(PolicyKind::ECONOMY),lastSelectedIndex(-1),lastSelectedPosition(-1),numberOfFacilities(0),builtFacilities(){}
 
+    const char* EconomySelection::getName() const{
+        return "eco";
     }
 
-    const string EconomySelection::toString() const{
-        return builtFacilitiesList;
+    const string EconomySelection::toString(const FacilityCatalog& facilitiesOptions) const{
+        return builtFacilities.toString(facilitiesOptions);
     }
 
     EconomySelection* EconomySelection::clone()const {
         EconomySelection* clone = new EconomySelection();
-        clone->builtFacilitiesList = this->builtFacilitiesList;
+        clone->builtFacilities = this->builtFacilities;
         clone->lastSelectedIndex = this->lastSelectedIndex;
+        clone->lastSelectedPosition = this->lastSelectedPosition;
         clone->numberOfFacilities = this->numberOfFacilities;
 
         return clone;
 
     }
 
-SustainabilitySelection::SustainabilitySelection():lastSelectedIndex(-1),numberOfFacilities(0),builtFacilitiesList("Built Facilities list:"){}
-
-const FacilityType& SustainabilitySelection::selectFacility(const vector<FacilityType>& facilitiesOptions){
-
-    numberOfFacilities++;
-    int i;
-    bool inside_start = false;
-
-
-    if(lastSelectedIndex == -1 || lastSelectedIndex + 1 == static_cast<int>(facilitiesOptions.size())){
-        i = 0; 
+    bool EconomySelection::isPeriodic() const{
+        return true;
     }
 
-    else{
-        i = lastSelectedIndex + 1;
-        inside_start = true;
+    int EconomySelection::getCursor() const{
+        return lastSelectedIndex;
     }
 
-    
-    const FacilityType* current = & facilitiesOptions[i];
-
-        while(current->getCategory()!= FacilityCategory::ENVIRONMENT){
-            if(!inside_start){
-                i++;
-                current = &facilitiesOptions[i];
-            }
-            else{
-                if(i == (static_cast<int>(facilitiesOptions.size()) - 1)){
-                    i = 0;
-                }
-                else{
-                    i++;
-                }
-                current = &facilitiesOptions[i];
-
-            }
-
-
+    void EconomySelection::save(BinaryWriter &writer) const{
+        saveKind(writer);
+        writer.writeSignedVarint(lastSelectedIndex);
+        writer.writeSignedVarint(numberOfFacilities);
+        builtFacilities.save(writer);
     }
 
+    EconomySelection* EconomySelection::load(BinaryReader &reader, int numOfFacilityOptions){
+        int lastSelectedIndex = reader.readInt();
+        int numberOfFacilities = reader.readInt();
+        if (lastSelectedIndex < -1 || lastSelectedIndex >= numOfFacilityOptions) {
+            throw std::runtime_error("Corrupt selection policy in snapshot");
+        }
+        SelectionHistory builtFacilities;
+        builtFacilities.load(reader, numOfFacilityOptions);
+
+        EconomySelection* policy = new EconomySelection();
+        policy->lastSelectedIndex = lastSelectedIndex;
+        policy->numberOfFacilities = numberOfFacilities;
+        policy->builtFacilities = builtFacilities;
+        return policy;
+    }
 
-    builtFacilitiesList += "\n" + std::to_string(numberOfFacilities) + ". "  + current->getName();
-    lastSelectedIndex = i;
-
-    return *current;
+SustainabilitySelection::SustainabilitySelection():SelectionPolicy(PolicyKind::SUSTAINABILITY),lastSelectedIndex(-1),lastSelectedPosition(-1),numberOfFacilities(0),builtFacilities(){}
 
+     const char* SustainabilitySelection::getName() const{
+        return "env";
     }
 
-     const string SustainabilitySelection::toString() const{
-        return builtFacilitiesList;
+     const string SustainabilitySelection::toString(const FacilityCatalog& facilitiesOptions) const{
+        return builtFacilities.toString(facilitiesOptions);
     }
 
 
      SustainabilitySelection* SustainabilitySelection::clone()const {
         SustainabilitySelection* clone = new SustainabilitySelection();
-        clone->builtFacilitiesList = this->builtFacilitiesList;
+        clone->builtFacilities = this->builtFacilities;
         clone->lastSelectedIndex = this->lastSelectedIndex;
+        clone->lastSelectedPosition = this->lastSelectedPosition;
         clone->numberOfFacilities = this->numberOfFacilities;
 
         return clone;
 
     }
+
+     bool SustainabilitySelection::isPeriodic() const{
+        return true;
+    }
+
+     int SustainabilitySelection::getCursor() const{
+        return lastSelectedIndex;
+    }
+
+     void SustainabilitySelection::save(BinaryWriter &writer) const{
+        saveKind(writer);
+        writer.writeSignedVarint(lastSelectedIndex);
+        writer.writeSignedVarint(numberOfFacilities);
+        builtFacilities.save(writer);
+    }
+
+     SustainabilitySelection* SustainabilitySelection::load(BinaryReader &reader, int numOfFacilityOptions){
+        int lastSelectedIndex = reader.readInt();
+        int numberOfFacilities = reader.readInt();
+        if (lastSelectedIndex < -1 || lastSelectedIndex >= numOfFacilityOptions) {
+            throw std::runtime_error("Corrupt selection policy in snapshot");
+        }
+        SelectionHistory builtFacilities;
+        builtFacilities.load(reader, numOfFacilityOptions);
+
+        SustainabilitySelection* policy = new SustainabilitySelection();
+        policy->lastSelectedIndex = lastSelectedIndex;
+        policy->numberOfFacilities = numberOfFacilities;
+        policy->builtFacilities = builtFacilities;
+        return policy;
+    }
@@ -1,4 +1,5 @@
 #include "Settlement.h"
+#include "MemoryPool.h"
 #include <string>
 #include <vector>
 #include <string>
@@ -6,8 +7,17 @@
 using std::string;
 using std::to_string;
 
-    Settlement::Settlement(const string &name, SettlementType type) : name(name),type(type){};
-    Settlement::Settlement(const Settlement& other):name(other.name),type(other.type){};
+    void* Settlement::operator new(size_t size) {
+        return MemoryPool::allocateObject(size);
+    }
+
+    void Settlement::operator delete(void* pointer, size_t size) {
+        MemoryPool::deallocateObject(pointer, size);
+    }
+
+    Settlement::Settlement(const string &name, SettlementType type) : Settlement(name, type, getDefaultConstructionCap(type)){};
+    Settlement::Settlement(const string &name, SettlementType type, int constructionCap) : name(name),type(type),constructionCap(constructionCap){};
+    Settlement::Settlement(const Settlement& other):name(other.name),type(other.type),constructionCap(other.constructionCap){};
    
 
     const string& Settlement:: getName()const {
@@ -17,6 +27,15 @@ using std::to_string;
     SettlementType Settlement::getType()const {
         return type;
     };
+
+    int Settlement::getConstructionCap()const {
+        return constructionCap;
+    };
+
+    // Village 1, city 2, metropolis 3, unless the configuration file gives a cap.
+    int Settlement::getDefaultConstructionCap(SettlementType type) {
+        return static_cast<int>(type) + 1;
+    };
     
     const string Settlement:: toString()const{
         string output =  "Settlement Name: " + name + ", Type: " + settlementTypeToString(type);
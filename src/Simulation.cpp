@@ -3,136 +3,110 @@
 #include <string>         
 #include <vector>         
 #include <stdexcept>     
+#include <algorithm>
+#include <mutex>
 #include "Simulation.h"
+#include "ConfigLoader.h"
 #include <iostream>
 using std::cout;
 using std::endl;
 
-Simulation::Simulation(const string &configFilePath):
+Simulation::Simulation(const string &configFilePath, int numOfThreads):
+memoryPool(std::make_shared<MemoryPool>()),
 isRunning(false), 
 planCounter(0),
 actionsLog(),
 plans(),
+currentStep(0),
+planSteps(),
 settlements(),
-facilitiesOptions()
+facilitiesOptions(),
+settlementIndex(),
+planIndex(),
+numOfThreads(1),
+stepPool(nullptr)
 {
-     std::ifstream configFile(configFilePath);
-    if (!configFile.is_open()) {
-        throw std::runtime_error("Failed to open configuration file: " + configFilePath);
-    }
-    
-    if (configFile.peek() == std::ifstream::traits_type::eof()) {
-        throw std::runtime_error("Configuration file is empty: " + configFilePath + "  ,Please add valid configFile and start again");
-    }
-
-    string line;
-    while (std::getline(configFile, line)) {
-        std::istringstream iss(line);
-        string type;
-        iss >> type;
-
-        if (type == "settlement") {
-            string name;
-            int settlementType;
-            iss >> name >> settlementType;
-            settlements.push_back(new Settlement(name, static_cast<SettlementType>(settlementType)));
-        } 
-        else if (type == "facility") {
-            string name;
-            int category, price, lifeqImpact, ecoImpact, envImpact;
-            iss >> name >> category >> price >> lifeqImpact >> ecoImpact >> envImpact;
-            facilitiesOptions.emplace_back(name, static_cast<FacilityCategory>(category), price, lifeqImpact, ecoImpact, envImpact);
-        } 
-        else if (type == "plan") {
-            string settlementName, policyType;
-            iss >> settlementName >> policyType;
-
-            SelectionPolicy* policy = nullptr;
-            if (policyType == "eco") {
-                policy = new EconomySelection();
-            } 
-            else if (policyType == "bal") {
-                policy = new BalancedSelection(0, 0, 0);
-                
-            } 
-            
-            else if (policyType == "env") {
-                policy = new SustainabilitySelection();
-            }
-
-            Settlement& settlement = getSettlement(settlementName);
-            addPlan(settlement, policy);
-        }
-    }
-
-    configFile.close();
+    setNumOfThreads(numOfThreads);
+    MemoryPool::Scope scope(&memoryPool);
+    ConfigLoader::load(configFilePath, *this, getThreadPool());
 }
 
 
+/*
+Copies share every plan, settlement, catalog entry and logged action with the
+original, so a backup costs a few reference counts (one per segment of plans).
+Whatever either side changes afterwards is copied at that point (see CopyOnWrite,
+SegmentedVector and ActionLog). They share the memory pool as well, since that is
+where the shared objects live.
+*/
 Simulation::Simulation(const Simulation& other)
-    : isRunning(other.isRunning),
+    : memoryPool(other.memoryPool),
+      isRunning(other.isRunning),
       planCounter(other.planCounter),
-      actionsLog(), 
+      actionsLog(other.actionsLog), 
       plans(other.plans),  
-      settlements(),  
-      facilitiesOptions(other.facilitiesOptions)
+      currentStep(other.currentStep),
+      planSteps(other.planSteps),
+      settlements(other.settlements),  
+      facilitiesOptions(other.facilitiesOptions),
+      settlementIndex(other.settlementIndex),
+      planIndex(other.planIndex),
+      numOfThreads(other.numOfThreads),
+      stepPool(nullptr)
 {
-    for (BaseAction* action : other.actionsLog) {
-        actionsLog.push_back(action->clone());
-    }
-
-    for (Settlement* settlement : other.settlements) {
-        settlements.push_back(new Settlement(*settlement));
-    }
 }
 
 
 
 
 Simulation::Simulation(Simulation&& other)
-    : isRunning(other.isRunning),
+    : memoryPool(other.memoryPool),
+      isRunning(other.isRunning),
       planCounter(other.planCounter),
       actionsLog(std::move(other.actionsLog)),
       plans(std::move(other.plans)),
+      currentStep(other.currentStep),
+      planSteps(std::move(other.planSteps)),
       settlements(std::move(other.settlements)),
-      facilitiesOptions(std::move(other.facilitiesOptions))
+      facilitiesOptions(std::move(other.facilitiesOptions)),
+      settlementIndex(std::move(other.settlementIndex)),
+      planIndex(std::move(other.planIndex)),
+      numOfThreads(other.numOfThreads),
+      stepPool(other.stepPool)
       
 {
-    other.actionsLog.clear();
-    other.settlements.clear();
+    other.stepPool = nullptr;
 }
 
+/*
+Trades states with the other simulation, pool included, so the old state is torn
+down with the other one: if nothing else holds the old pool, that is one release.
+*/
 Simulation& Simulation::operator=(Simulation&& other) {
     if(this != &other) {
-        for(BaseAction* action : actionsLog) {
-            delete action;
-        }
-        for(Settlement* settlement : settlements) {
-            delete settlement;
-        }
-        
-        isRunning = other.isRunning;
-        planCounter = other.planCounter;
-        plans = std::move(other.plans);
-        facilitiesOptions = std::move(other.facilitiesOptions);
-        actionsLog = std::move(other.actionsLog);
-        settlements = std::move(other.settlements);
-        
-        other.actionsLog.clear();
-        other.settlements.clear();
+        std::swap(memoryPool, other.memoryPool);
+        std::swap(isRunning, other.isRunning);
+        std::swap(planCounter, other.planCounter);
+        std::swap(plans, other.plans);
+        std::swap(currentStep, other.currentStep);
+        std::swap(planSteps, other.planSteps);
+        std::swap(facilitiesOptions, other.facilitiesOptions);
+        std::swap(actionsLog, other.actionsLog);
+        std::swap(settlements, other.settlements);
+        std::swap(settlementIndex, other.settlementIndex);
+        std::swap(planIndex, other.planIndex);
+        std::swap(numOfThreads, other.numOfThreads);
+        std::swap(stepPool, other.stepPool);
     }
     return *this;
 }
 
 Simulation::~Simulation() {
-    for (BaseAction* action : actionsLog) {
-        delete action;
+    delete stepPool;
+    // Nobody else uses the pool, so the members below give their memory back with it.
+    if (memoryPool.use_count() == 1) {
+        memoryPool->release();
     }
-
-    for (Settlement* settlement : settlements) {
-        delete settlement;
-    }
-
 }
 
 Simulation& Simulation::operator=(const Simulation& other) {
@@ -140,54 +114,53 @@ Simulation& Simulation::operator=(const Simulation& other) {
         return *this;
     }
 
-    for(BaseAction* currentAction : this->actionsLog){
-        delete currentAction;
-    }
-    actionsLog.clear();
-
-     plans.clear();
-
-    for(Settlement* currentSettlement : this->settlements){
-        delete currentSettlement;
-    }
-    settlements.clear();
-    
-   
-    facilitiesOptions.clear();
-
+    std::shared_ptr<MemoryPool> previous = replacePool(other.memoryPool);
     this->isRunning = other.isRunning;
     this->planCounter = other.planCounter;
+    this->actionsLog = other.actionsLog;
+    this->plans = other.plans;
+    this->currentStep = other.currentStep;
+    this->planSteps = other.planSteps;
+    this->settlements = other.settlements;
+    this->facilitiesOptions = other.facilitiesOptions;
+    this->settlementIndex = other.settlementIndex;
+    this->planIndex = other.planIndex;
 
-    for(BaseAction* currentOtherAction : other.actionsLog){
-        BaseAction* currentOtherActionCopy = currentOtherAction->clone();
-        this->actionsLog.push_back(currentOtherActionCopy);
-    }
-
-    for(const Plan& currentOtherPlan : other.plans){
-        this->plans.emplace_back(currentOtherPlan);
-    }
-
-    for(Settlement* currentOtherSettlement : other.settlements){
-        Settlement* currentOtherSettlementCopy = new Settlement(*currentOtherSettlement);
-        this->settlements.push_back(currentOtherSettlementCopy);  
-    }
+    return *this;
+}
 
-    for(const FacilityType& currentOtherFacility : other.facilitiesOptions){
-        this->facilitiesOptions.emplace_back(currentOtherFacility);
+/*
+Takes the pool the new state lives in and hands back the old one, which the caller
+keeps until the old state has been replaced. If the old pool was this simulation's
+alone, nothing of it is still needed after that, so it is released first and goes
+back whole instead of object by object.
+*/
+std::shared_ptr<MemoryPool> Simulation::replacePool(const std::shared_ptr<MemoryPool> &pool) {
+    std::shared_ptr<MemoryPool> previous(memoryPool);
+    memoryPool = pool;
+    if (previous != memoryPool && previous.use_count() == 1) {
+        previous->release();
     }
-
-    return *this;
+    return previous;
 }
 
 
-void Simulation::start() {
+/*
+Runs commands from input until close or the end of input. Without prompts (batch
+mode) nothing but the commands' own output is written.
+*/
+void Simulation::start(std::istream &input, bool showPrompts) {
     isRunning = true; 
     cout << "Simulation started. Enter commands:\n";
 
     while (isRunning) {
-        cout << "> "; 
+        if (showPrompts) {
+            cout << "> "; 
+        }
         string command;
-        getline(cin, command); 
+        if (!getline(input, command)) {
+            break;
+        }
 
         std::istringstream iss(command);
         string actionType;
@@ -199,8 +172,7 @@ void Simulation::start() {
 
             if (!iss.fail()) {
                 SimulateStep* action = new SimulateStep(numOfSteps); 
-                action->act(*this);
-                addAction(action);
+                run(action, Metrics::ACTION_STEP);
 
             } else {
                 cout << "Invalid input for step command. Syntax: step <number of steps>\n";
@@ -212,8 +184,7 @@ void Simulation::start() {
 
             if (!iss.fail()) {
                 AddPlan* action = new AddPlan(settlementName, policyType);
-                action->act(*this);
-                addAction(action);
+                run(action, Metrics::ACTION_PLAN);
             } else {
                 cout << "Invalid input for plan command. Syntax: plan <settlement_name> <selection_policy>\n";
             }
@@ -225,8 +196,7 @@ void Simulation::start() {
 
             if (!iss.fail() && (settlementType == 0 || settlementType == 1 || settlementType == 2)) {
                 AddSettlement* action = new AddSettlement(settlementName, static_cast<SettlementType>(settlementType));
-                action->act(*this);
-                addAction(action);
+                run(action, Metrics::ACTION_SETTLEMENT);
             } else {
                 cout << "Invalid input for settlement command. Syntax: settlement <settlement_name> <settlement_type (0: village, 1: city, 2: metropolis)>\n";
             }
@@ -238,8 +208,7 @@ void Simulation::start() {
 
             if (!iss.fail()) {
                 AddFacility* action = new AddFacility(facilityName, static_cast<FacilityCategory>(category), price, lifeqImpact, ecoImpact, envImpact);
-                action->act(*this);
-                addAction(action);
+                run(action, Metrics::ACTION_FACILITY);
             } else {
                 cout << "Invalid input for facility command. Syntax: facility <facility_name> <category> <price> <lifeq_impact> <eco_impact> <env_impact>\n";
             }
@@ -250,8 +219,7 @@ void Simulation::start() {
 
             if (!iss.fail()) {
                 PrintPlanStatus* action = new PrintPlanStatus(planId);
-                action->act(*this);
-                addAction(action);
+                run(action, Metrics::ACTION_PLAN_STATUS);
             } else {
                 cout << "Invalid input for planStatus command. Syntax: planStatus <plan_id>\n";
             }
@@ -263,31 +231,76 @@ void Simulation::start() {
 
             if (!iss.fail()) {
                 ChangePlanPolicy* action = new ChangePlanPolicy(planId, newPolicy);
-                action->act(*this);
-                addAction(action);
+                run(action, Metrics::ACTION_CHANGE_POLICY);
             } else {
                 cout << "Invalid input for changePolicy command. Syntax: changePolicy <plan_id> <selection_policy>\n";
             }
         }
         else if (actionType == "log") {
             PrintActionsLog* action = new PrintActionsLog();
-            action->act(*this);
-            addAction(action);
+            run(action, Metrics::ACTION_LOG);
         }
         else if (actionType == "close") {
             Close* action = new Close();
-            action->act(*this); 
-            addAction(action);
+            run(action, Metrics::ACTION_CLOSE);
         }
         else if (actionType == "backup") {
-            BackupSimulation* action = new BackupSimulation();
-            action->act(*this);
-            addAction(action);
+            string filePath;
+            iss >> filePath;
+            BackupSimulation* action = new BackupSimulation(filePath);
+            run(action, Metrics::ACTION_BACKUP);
         }
         else if (actionType == "restore") {
-            RestoreSimulation* action = new RestoreSimulation();
-            action->act(*this);
-            addAction(action);
+            string filePath;
+            iss >> filePath;
+            RestoreSimulation* action = new RestoreSimulation(filePath);
+            run(action, Metrics::ACTION_RESTORE);
+        }
+        else if (actionType == "optimize") {
+            int planId, horizon;
+            string objective;
+            iss >> planId >> horizon >> objective;
+
+            if (!iss.fail()) {
+                OptimizePlan* action = new OptimizePlan(planId, horizon, objective);
+                run(action, Metrics::ACTION_OPTIMIZE);
+            } else {
+                cout << "Invalid input for optimize command. Syntax: optimize <plan_id> <horizon> <objective (lq, eco, env, min, balance)>\n";
+            }
+        }
+        else if (actionType == "top") {
+            string metric;
+            int count;
+            iss >> metric >> count;
+
+            if (!iss.fail()) {
+                TopPlans* action = new TopPlans(metric, count);
+                run(action, Metrics::ACTION_TOP);
+            } else {
+                cout << "Invalid input for top command. Syntax: top <metric (lq, eco, env)> <k>\n";
+            }
+        }
+        else if (actionType == "aggregate") {
+            string metric, by, grouping;
+            iss >> metric >> by >> grouping;
+
+            if (!iss.fail() && by == "by") {
+                AggregatePlans* action = new AggregatePlans(metric, grouping);
+                run(action, Metrics::ACTION_AGGREGATE);
+            } else {
+                cout << "Invalid input for aggregate command. Syntax: aggregate <metric (lq, eco, env)> by <settlement|type|policy>\n";
+            }
+        }
+        else if (actionType == "stats") {
+            string format;
+            iss >> format;
+
+            if (format.empty() || format == "json") {
+                PrintStats* action = new PrintStats(format);
+                run(action, Metrics::ACTION_STATS);
+            } else {
+                cout << "Invalid input for stats command. Syntax: stats [json]\n";
+            }
         }
         else {
             cout << "Unknown command: " << actionType << "\n";
@@ -301,85 +314,431 @@ void Simulation::start() {
 
 void Simulation::addPlan(const Settlement &settlement, SelectionPolicy *selectionPolicy){
     planCounter++;
-    plans.emplace_back(planCounter, settlement, selectionPolicy, facilitiesOptions);
+    planIndex.addPlan(plans.emplace_back(Plan(planCounter, shareSettlement(settlement), selectionPolicy)).read());
+    planSteps.emplace_back(currentStep);
 }
 
 void Simulation::addAction(BaseAction *action){
-    actionsLog.push_back(action);
+    actionsLog.append(action);
 }
 
+/*
+Runs a command's action, records how long it took and whether it failed, and logs it.
+*/
+void Simulation::run(BaseAction *action, Metrics::Timer timer){
+    MemoryPool::Scope scope(&memoryPool);
+    const uint64_t begin = Metrics::now();
+    action->act(*this);
+    Metrics::record(timer, Metrics::now() - begin);
+    if (action->getStatus() == ActionStatus::ERROR) {
+        Metrics::recordError(timer);
+    }
+    addAction(action);
+}
+
+/*
+Takes ownership of the settlement only when it is added. A settlement or facility
+whose name is already taken is refused, and the caller keeps it.
+*/
 bool Simulation::addSettlement(Settlement *settlement){
-    settlements.push_back(settlement);
+    const int position = static_cast<int>(settlements.read().size());
+    if (!settlementIndex.write().insert(std::make_pair(settlement->getName(), position)).second) {
+        return false;
+    }
+    settlements.write().emplace_back(settlement);
     return true;
 } 
 
 bool Simulation::addFacility(FacilityType facility){
-    facilitiesOptions.push_back(facility);
-    return true;
+    if (facilitiesOptions.read().contains(facility.getName())) {
+        return false;
+    }
+    return facilitiesOptions.write().add(facility);
 }
-bool Simulation::isSettlementExists(const string &settlementName){
 
-    for (Settlement* settlement : settlements) {
+bool Simulation::isSettlementExists(const string &settlementName) const{
+    return settlementIndex.read().count(settlementName) > 0;
+}
 
-        if (settlement->getName() == settlementName) {
-            return true;   
-        }
+const Settlement& Simulation::getSettlement(const string& settlementName) const{
+    std::unordered_map<string, int>::const_iterator position = settlementIndex.read().find(settlementName);
+    if (position == settlementIndex.read().end()) {
+        throw std::out_of_range("Settlement doesn't exist.");
     }
-    return false; 
+    return *settlements.read()[position->second];
+}
 
+// The settlement registered under the name, or null.
+std::shared_ptr<const Settlement> Simulation::findSettlement(const string &settlementName) const{
+    std::unordered_map<string, int>::const_iterator position = settlementIndex.read().find(settlementName);
+    if (position == settlementIndex.read().end()) {
+        return std::shared_ptr<const Settlement>();
+    }
+    return settlements.read()[position->second];
 }
 
-Settlement& Simulation::getSettlement(const string& settlementName){
-    Settlement* output = nullptr;
- 
-    for (Settlement* settelment_obj : settlements){
-        if(settelment_obj->getName() == settlementName){
-            output = settelment_obj;
-        }        
+/*
+The registered settlement with the same name, type and cap, so plans share it instead
+of each keeping a copy. One that matches none is copied into the memory pool.
+*/
+std::shared_ptr<const Settlement> Simulation::shareSettlement(const Settlement &settlement) const{
+    std::shared_ptr<const Settlement> registered = findSettlement(settlement.getName());
+    if (registered && registered->getType() == settlement.getType() && registered->getConstructionCap() == settlement.getConstructionCap()) {
+        return registered;
     }
-    return *output;
+    return std::allocate_shared<Settlement>(PoolAllocator<Settlement>(), settlement);
+}
+
+bool Simulation::isFacilityExists(const string &facilityName) const{
+    return facilitiesOptions.read().contains(facilityName);
 }
 
 Plan& Simulation::getPlan(const int planID){
    if (!isPlanExists(planID)) {
         throw std::out_of_range("Plan ID is out of range.");
     }
-    return plans[planID];
+    planIndex.markChanged(planID);
+    return catchUp(planID);
 
 }
 
+// The countdowns of a plan that was left behind (see advance) may be behind; everything else is current.
+const Plan& Simulation::viewPlan(const int planID) const{
+   if (!isPlanExists(planID)) {
+        throw std::out_of_range("Plan ID is out of range.");
+    }
+    return plans[planID].read();
+
+}
+
+// A copy of the plan brought up to the current step, to look ahead without changing it.
+Plan Simulation::copyPlan(const int planID) const{
+    Plan copy(viewPlan(planID));
+    copy.skip(currentStep - planSteps[planID]);
+    return copy;
+}
+
+/*
+Brings a plan that was left behind up to the current step and returns it for
+changing. It had nothing due in the steps it missed, so they only count its
+buildings down.
+*/
+Plan& Simulation::catchUp(int planID) {
+    Plan& plan = plans.write(planID).write();
+    const long long stepsBehind = currentStep - planSteps[planID];
+    if (stepsBehind > 0) {
+        plan.skip(stepsBehind);
+        planSteps.write(planID) = currentStep;
+    }
+    return plan;
+}
+
 void Simulation::step() {
-    for (Plan& plan : plans) {
-        plan.step();
+    advance(1);
+}
+
+/*
+Same result as calling step() numOfSteps times. Plans don't interact, so each plan
+runs the whole span on its own with Plan::advance, which only does work at its own
+events rather than at every plan's events. A plan with nothing due in the span isn't
+written at all, so it stays shared with backups; it is left behind and catches up
+on its countdowns when it is next stepped or changed. Every task notes the scores of
+the plans it changed, and the plan index takes all of them at the end.
+*/
+void Simulation::advance(int numOfSteps) {
+    MemoryPool::Scope scope(&memoryPool);
+    const uint64_t begin = Metrics::now();
+    const Metrics::Snapshot before = Metrics::snapshot();
+
+    SegmentedVector<CopyOnWrite<Plan>>& plans = this->plans;
+    SegmentedVector<long long>& planSteps = this->planSteps;
+    const long long currentStep = this->currentStep;
+    planIndex.refresh(plans);
+    plans.unshare();
+    planSteps.unshare();
+    const FacilityCatalog& facilitiesOptions = this->facilitiesOptions.read();
+    std::mutex changesLock;
+    vector<PlanIndex::Change> changes;
+    runOnPlans([&plans, &planSteps, currentStep, &facilitiesOptions, numOfSteps, &changesLock, &changes](size_t begin, size_t end) {
+        vector<PlanIndex::Change> mine;
+        uint64_t stepsLeftBehind = 0;
+        for (size_t i = begin; i < end; i++) {
+            const long long stepsBehind = currentStep - planSteps[i];
+            const int next = plans[i].read().stepsToNextEvent(facilitiesOptions);
+            if (next == -1 || next - stepsBehind > numOfSteps) {
+                stepsLeftBehind += numOfSteps;
+                continue;
+            }
+            Plan& plan = plans.write(i).write();
+            plan.skip(stepsBehind);
+            planSteps.write(i) = currentStep + numOfSteps;
+            PlanIndex::Change change;
+            change.planId = static_cast<int>(i);
+            change.before[PlanIndex::LIFE_QUALITY] = plan.getlifeQualityScore();
+            change.before[PlanIndex::ECONOMY] = plan.getEconomyScore();
+            change.before[PlanIndex::ENVIRONMENT] = plan.getEnvironmentScore();
+            plan.advance(facilitiesOptions, numOfSteps);
+            change.after[PlanIndex::LIFE_QUALITY] = plan.getlifeQualityScore();
+            change.after[PlanIndex::ECONOMY] = plan.getEconomyScore();
+            change.after[PlanIndex::ENVIRONMENT] = plan.getEnvironmentScore();
+            if (!std::equal(change.before, change.before + PlanIndex::NUM_OF_METRICS, change.after)) {
+                mine.push_back(change);
+            }
+        }
+        Metrics::add(Metrics::PLAN_STEPS, stepsLeftBehind);
+        if (!mine.empty()) {
+            std::lock_guard<std::mutex> guard(changesLock);
+            changes.insert(changes.end(), mine.begin(), mine.end());
+        }
+    });
+    planIndex.apply(changes);
+    this->currentStep += numOfSteps;
+
+    const Metrics::Snapshot after = Metrics::snapshot();
+    Metrics::add(Metrics::SIMULATED_STEPS, numOfSteps);
+    Metrics::set(Metrics::LAST_STEP_STEPS, numOfSteps);
+    Metrics::set(Metrics::LAST_STEP_STARTED,
+                 after.counters[Metrics::FACILITIES_STARTED] - before.counters[Metrics::FACILITIES_STARTED]);
+    Metrics::set(Metrics::LAST_STEP_COMPLETED,
+                 after.counters[Metrics::FACILITIES_COMPLETED] - before.counters[Metrics::FACILITIES_COMPLETED]);
+    Metrics::record(Metrics::SIMULATION_STEP, Metrics::now() - begin);
+}
+
+void Simulation::setNumOfThreads(int numOfThreads) {
+    if (numOfThreads < 1) {
+        numOfThreads = 1;
+    }
+    if (stepPool != nullptr && stepPool->getNumOfThreads() != numOfThreads) {
+        delete stepPool;
+        stepPool = nullptr;
     }
+    this->numOfThreads = numOfThreads;
 }
 
-void Simulation::close() {
-    isRunning = false;
+int Simulation::getNumOfThreads() const {
+    return numOfThreads;
+}
 
-    for (BaseAction* action : actionsLog) {
-        delete action;
+/*
+The pool shared by everything the simulation runs in parallel, started on first use.
+Null when running on a single thread.
+*/
+ThreadPool* Simulation::getThreadPool() {
+    if (numOfThreads > 1 && stepPool == nullptr) {
+        stepPool = new ThreadPool(numOfThreads);
     }
-    actionsLog.clear();
+    return stepPool;
+}
+
+/*
+Plans never touch each other's state, so the plan list is cut into chunks that are
+stepped on the pool. A plan's cost grows with its construction cap (village 1,
+metropolis 3), so chunks are cut by total cap rather than by plan count, and there
+are several chunks per thread so work stealing can even out what is left.
+*/
+void Simulation::runOnPlans(const std::function<void(size_t, size_t)> &work) {
+    const SegmentedVector<CopyOnWrite<Plan>>& plans = this->plans;
+    if (numOfThreads <= 1 || plans.size() < 2) {
+        work(0, plans.size());
+        return;
+    }
+    ThreadPool* pool = getThreadPool();
 
-    for (Settlement* settlement : settlements) {
-        delete settlement;
+    long totalWeight = 0;
+    for (size_t i = 0; i < plans.size(); i++) {
+        totalWeight += plans[i].read().getConstructionCap();
     }
-    settlements.clear();
+    const long chunkWeight = std::max(1L, totalWeight / (numOfThreads * 8L));
+
+    vector<std::function<void()>> tasks;
+    size_t begin = 0;
+    long weight = 0;
+    for (size_t i = 0; i < plans.size(); i++) {
+        weight += plans[i].read().getConstructionCap();
+        if (weight >= chunkWeight || i + 1 == plans.size()) {
+            size_t end = i + 1;
+            tasks.push_back([&work, begin, end] { work(begin, end); });
+            begin = end;
+            weight = 0;
+        }
+    }
+    pool->run(tasks);
 }
 
-void Simulation::open() {
-    isRunning = true;
+void Simulation::close() {
+    isRunning = false;
+
+    actionsLog.clear();
+    settlements.write().clear();
+    settlementIndex.write().clear();
 }
 
-const vector<BaseAction*>& Simulation::getActionsLog() const {
+const ActionLog& Simulation::getActionsLog() const {
     return actionsLog;
 }
 
-bool Simulation::isPlanExists(const int planID) {
-    return planID >= 0 && planID < static_cast<int>(plans.size());
+bool Simulation::isPlanExists(const int planID) const {
+    return planID >= 0 && planID < getNumOfPlans();
+}
+
+int Simulation::getNumOfPlans() const {
+    return static_cast<int>(plans.size());
 }
 
-const std::vector<Plan>& Simulation::getPlans() const {
-    return plans;
+const FacilityCatalog& Simulation::getFacilitiesOptions() const {
+    return facilitiesOptions.read();
+}
+
+// Reads the plans added, or changed through getPlan, since the index was last brought up to date.
+const PlanIndex& Simulation::getPlanIndex() {
+    planIndex.refresh(plans);
+    return planIndex;
+}
+
+/*
+Snapshot image layout (all numbers varints unless noted):
+  magic "SPLSIM\0\0", version
+  plan counter
+  facility options: count, then name, category, price, three scores for each
+  settlements: count, then name, type and construction cap for each
+  plans: count, then Plan::save for each
+  actions log: count, then BaseAction::save for each
+Version 2 images have no construction caps; their settlements get the default ones.
+*/
+static const char SNAPSHOT_MAGIC[8] = {'S', 'P', 'L', 'S', 'I', 'M', 0, 0};
+static const uint64_t SNAPSHOT_VERSION = 3;
+static const uint64_t OLDEST_SNAPSHOT_VERSION = 2;
+
+void Simulation::saveSnapshot(const string &filePath) const {
+    BinaryWriter writer;
+    writer.writeBytes(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    writer.writeVarint(SNAPSHOT_VERSION);
+    writer.writeSignedVarint(planCounter);
+
+    const vector<FacilityType>& facilitiesOptions = this->facilitiesOptions.read().getOptions();
+    writer.writeVarint(facilitiesOptions.size());
+    for (const FacilityType& facility : facilitiesOptions) {
+        writer.writeString(facility.getName());
+        writer.writeByte(static_cast<uint8_t>(facility.getCategory()));
+        writer.writeSignedVarint(facility.getCost());
+        writer.writeSignedVarint(facility.getLifeQualityScore());
+        writer.writeSignedVarint(facility.getEconomyScore());
+        writer.writeSignedVarint(facility.getEnvironmentScore());
+    }
+
+    const vector<std::shared_ptr<const Settlement>>& settlements = this->settlements.read();
+    writer.writeVarint(settlements.size());
+    for (const std::shared_ptr<const Settlement>& settlement : settlements) {
+        writer.writeString(settlement->getName());
+        writer.writeByte(static_cast<uint8_t>(settlement->getType()));
+        writer.writeSignedVarint(settlement->getConstructionCap());
+    }
+
+    writer.writeVarint(plans.size());
+    for (size_t i = 0; i < plans.size(); i++) {
+        plans[i].read().save(writer, currentStep - planSteps[i]);
+    }
+
+    writer.writeVarint(actionsLog.size());
+    actionsLog.forEach([&writer](const BaseAction& action) {
+        action.save(writer);
+    });
+
+    writer.writeToFile(filePath);
+}
+
+/*
+Maps the image and rebuilds the whole state from it. Nothing is replaced unless the
+image reads back completely, so a bad file leaves the simulation as it was.
+*/
+void Simulation::loadSnapshot(const string &filePath) {
+    MappedFile file(filePath);
+    BinaryReader reader(file.begin(), file.end());
+
+    const char* magic = reader.readBytes(sizeof(SNAPSHOT_MAGIC));
+    if (!std::equal(magic, magic + sizeof(SNAPSHOT_MAGIC), SNAPSHOT_MAGIC)) {
+        throw std::runtime_error("Not a simulation snapshot: " + filePath);
+    }
+    const uint64_t version = reader.readVarint();
+    if (version < OLDEST_SNAPSHOT_VERSION || version > SNAPSHOT_VERSION) {
+        throw std::runtime_error("Unsupported snapshot version: " + filePath);
+    }
+
+    // A pool no backup holds is reused, free lists and all; otherwise the backups keep the old one.
+    const bool sharedPool = memoryPool.use_count() > 1;
+    Simulation loaded(*this);
+    if (sharedPool) {
+        loaded.memoryPool = std::make_shared<MemoryPool>();
+    }
+    MemoryPool::Scope scope(&loaded.memoryPool);
+    loaded.planCounter = reader.readInt();
+
+    loaded.facilitiesOptions = CopyOnWrite<FacilityCatalog>();
+    size_t numOfFacilities = reader.readCount();
+    loaded.facilitiesOptions.write().reserve(numOfFacilities);
+    for (size_t i = 0; i < numOfFacilities; i++) {
+        string name = reader.readString();
+        uint8_t category = reader.readByte();
+        int price = reader.readInt();
+        int lifeQualityScore = reader.readInt();
+        int economyScore = reader.readInt();
+        int environmentScore = reader.readInt();
+        if (category > static_cast<uint8_t>(FacilityCategory::ENVIRONMENT)) {
+            throw std::runtime_error("Corrupt facility in snapshot: " + filePath);
+        }
+        if (!loaded.addFacility(FacilityType(name, static_cast<FacilityCategory>(category), price, lifeQualityScore, economyScore, environmentScore))) {
+            throw std::runtime_error("Duplicate facility in snapshot: " + filePath);
+        }
+    }
+
+    loaded.settlements = CopyOnWrite<vector<std::shared_ptr<const Settlement>>>();
+    loaded.settlementIndex = CopyOnWrite<std::unordered_map<string, int>>();
+    size_t numOfSettlements = reader.readCount();
+    loaded.settlements.write().reserve(numOfSettlements);
+    loaded.settlementIndex.write().reserve(numOfSettlements);
+    for (size_t i = 0; i < numOfSettlements; i++) {
+        string name = reader.readString();
+        uint8_t type = reader.readByte();
+        if (type > static_cast<uint8_t>(SettlementType::METROPOLIS)) {
+            throw std::runtime_error("Corrupt settlement in snapshot: " + filePath);
+        }
+        int constructionCap = Settlement::getDefaultConstructionCap(static_cast<SettlementType>(type));
+        if (version >= 3) {
+            constructionCap = reader.readInt();
+        }
+        if (constructionCap < 1 || constructionCap > Settlement::MAX_CONSTRUCTION_CAP) {
+            throw std::runtime_error("Corrupt settlement in snapshot: " + filePath);
+        }
+        Settlement *settlement = new Settlement(name, static_cast<SettlementType>(type), constructionCap);
+        if (!loaded.addSettlement(settlement)) {
+            delete settlement;
+            throw std::runtime_error("Duplicate settlement in snapshot: " + filePath);
+        }
+    }
+
+    loaded.plans.clear();
+    loaded.currentStep = 0;
+    loaded.planSteps.clear();
+    loaded.planIndex = PlanIndex();
+    size_t numOfPlans = reader.readCount();
+    const std::function<std::shared_ptr<const Settlement>(const string&)> findSettlement = [&loaded](const string &name) {
+        return loaded.findSettlement(name);
+    };
+    for (size_t i = 0; i < numOfPlans; i++) {
+        loaded.planIndex.addPlan(loaded.plans.emplace_back(Plan::load(reader, static_cast<int>(numOfFacilities), findSettlement)).read());
+        loaded.planSteps.emplace_back(0);
+    }
+
+    loaded.actionsLog.clear();
+    size_t numOfActions = reader.readCount();
+    for (size_t i = 0; i < numOfActions; i++) {
+        loaded.actionsLog.append(BaseAction::load(reader));
+    }
+
+    if (!reader.atEnd()) {
+        throw std::runtime_error("Trailing data in snapshot: " + filePath);
+    }
+
+    loaded.isRunning = isRunning;
+    *this = std::move(loaded);
 }
@@ -0,0 +1,143 @@
+#include "ThreadPool.h"
+
+ThreadPool::WorkQueue::WorkQueue() : lock(), tasks() {}
+
+ThreadPool::ThreadPool(int numOfThreads)
+    : numOfThreads(numOfThreads < 1 ? 1 : numOfThreads),
+      queues(),
+      workers(),
+      stateLock(),
+      wakeup(),
+      done(),
+      pending(0),
+      taskPool(nullptr),
+      generation(0),
+      error(),
+      stopping(false)
+{
+    for (int i = 0; i < this->numOfThreads; i++) {
+        queues.push_back(new WorkQueue());
+    }
+    for (int i = 1; i < this->numOfThreads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(stateLock);
+        stopping = true;
+    }
+    wakeup.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    for (WorkQueue* queue : queues) {
+        delete queue;
+    }
+}
+
+int ThreadPool::getNumOfThreads() const {
+    return numOfThreads;
+}
+
+void ThreadPool::run(vector<std::function<void()>> &tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+
+    // A worker still spinning down from the previous run may pick tasks up as soon
+    // as they are queued, so the counter and the pool have to be in place first.
+    {
+        std::lock_guard<std::mutex> guard(stateLock);
+        pending = static_cast<int>(tasks.size());
+        taskPool = MemoryPool::Scope::getActive();
+        error = nullptr;
+        generation++;
+    }
+    for (size_t i = 0; i < tasks.size(); i++) {
+        WorkQueue* queue = queues[i % queues.size()];
+        std::lock_guard<std::mutex> guard(queue->lock);
+        queue->tasks.push_back(&tasks[i]);
+    }
+    wakeup.notify_all();
+
+    drain(0);
+
+    std::unique_lock<std::mutex> lock(stateLock);
+    done.wait(lock, [this] { return pending == 0; });
+    if (error) {
+        std::exception_ptr thrown = error;
+        error = nullptr;
+        std::rethrow_exception(thrown);
+    }
+}
+
+void ThreadPool::workerLoop(int workerId) {
+    int seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(stateLock);
+            wakeup.wait(lock, [this, seenGeneration] { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+        drain(workerId);
+    }
+}
+
+/*
+Runs tasks until there are none left. A task is run under the pool of the run it
+came from, which is published before its tasks are queued: a worker still draining
+may take a task of the next run. An exception ends only its own task; the first one
+is kept for run() to rethrow.
+*/
+void ThreadPool::drain(int workerId) {
+    std::function<void()>* task = nullptr;
+    while (popTask(workerId, task)) {
+        const std::shared_ptr<MemoryPool> *pool = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(stateLock);
+            pool = taskPool;
+        }
+        try {
+            MemoryPool::Scope scope(pool);
+            (*task)();
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(stateLock);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+        if (--pending == 0) {
+            std::lock_guard<std::mutex> guard(stateLock);
+            done.notify_all();
+        }
+    }
+}
+
+bool ThreadPool::popTask(int workerId, std::function<void()>* &task) {
+    WorkQueue* own = queues[workerId];
+    {
+        std::lock_guard<std::mutex> guard(own->lock);
+        if (!own->tasks.empty()) {
+            task = own->tasks.back();
+            own->tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (int offset = 1; offset < numOfThreads; offset++) {
+        WorkQueue* victim = queues[(workerId + offset) % numOfThreads];
+        std::lock_guard<std::mutex> guard(victim->lock);
+        if (!victim->tasks.empty()) {
+            task = victim->tasks.front();
+            victim->tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
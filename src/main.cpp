@@ -1,18 +1,63 @@
 #include "Simulation.h"
 #include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <unistd.h>
 
 using namespace std;
 
 Simulation* backup = nullptr;
 
+// Batch mode I/O buffers: output is only written when this fills up or at the end.
+static char outputBuffer[1 << 20];
+static char scriptBuffer[1 << 20];
+
 int main(int argc, char** argv){
-    if(argc!=2){
-        cout << "usage: simulation <config_path>" << endl;
+    int numOfThreads = 1;
+    string scriptFile;
+    bool validArguments = argc >= 2;
+    for(int i = 2; i < argc && validArguments; i++){
+        string option = argv[i];
+        if(option == "--threads" && i + 1 < argc){
+            numOfThreads = atoi(argv[++i]);
+        }
+        else if(option == "--script" && i + 1 < argc){
+            scriptFile = argv[++i];
+        }
+        else{
+            validArguments = false;
+        }
+    }
+    if(!validArguments || numOfThreads < 1){
+        cout << "usage: simulation <config_path> [--threads <number of threads>] [--script <commands_file>]" << endl;
         return 0;
     }
+
+    // Commands from a script or a pipe run in batch mode: no prompts, and output goes
+    // through one large buffer instead of being flushed line by line.
+    bool batchMode = !scriptFile.empty() || !isatty(STDIN_FILENO);
+    if(batchMode){
+        ios::sync_with_stdio(false);
+        cin.tie(nullptr);
+        cout.rdbuf()->pubsetbuf(outputBuffer, sizeof(outputBuffer));
+    }
+
     string configurationFile = argv[1];
-    Simulation simulation(configurationFile);
-    simulation.start();
+    Simulation simulation(configurationFile, numOfThreads);
+    if(!scriptFile.empty()){
+        ifstream script;
+        script.rdbuf()->pubsetbuf(scriptBuffer, sizeof(scriptBuffer));
+        script.open(scriptFile);
+        if(!script.is_open()){
+            cout << "Failed to open script file: " << scriptFile << endl;
+            return 0;
+        }
+        simulation.start(script, false);
+    }
+    else{
+        simulation.start(cin, !batchMode);
+    }
+    cout.flush();
     
     if(backup!=nullptr){
     	delete backup;
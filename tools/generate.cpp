@@ -0,0 +1,419 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Facility.h"
+#include "Settlement.h"
+using std::string;
+using std::vector;
+
+/*
+Writes a synthetic configuration file and a matching command script. The same
+arguments always give byte-identical files: every random choice comes from one
+seeded generator implemented here, not from the standard library's distributions,
+whose results differ between library versions.
+
+Usage: generate --config FILE [--script FILE] [options]
+    --seed N                  random seed (default 1)
+    --settlements N           number of settlements (default 100)
+    --types V:C:M             village:city:metropolis weights (default 1:1:1)
+    --facilities LQ:ECO:ENV   catalog size per category (default 10:10:10)
+    --price DIST:MIN:MAX      price distribution (default uniform:1:5)
+    --score DIST:MIN:MAX      score distribution (default uniform:0:5)
+    --plans NVE:BAL:ECO:ENV   number of plans per policy (default 25:25:25:25)
+    --commands N              commands in the script, not counting close (default 1000)
+    --mix NAME=W,...          command weights (default step=20,planStatus=10,changePolicy=5,
+                              plan=5,settlement=1,facility=1)
+    --max-step N              largest step count in a step command (default 10)
+
+DIST is uniform (every value equally likely) or skewed (low values more likely).
+Command names in --mix are step, plan, settlement, facility, planStatus,
+changePolicy, log, backup, restore, stats, top and aggregate. The script ends with
+close.
+*/
+
+/*
+splitmix64: small, fast and identical on every platform.
+*/
+class Random {
+    public:
+        explicit Random(uint64_t seed) : state(seed) {}
+
+        uint64_t next() {
+            uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            return z ^ (z >> 31);
+        }
+
+        // A value in [min, max].
+        long long between(long long min, long long max) {
+            return min + static_cast<long long>(next() % static_cast<uint64_t>(max - min + 1));
+        }
+
+        // An index into weights, each index chosen in proportion to its weight.
+        size_t pick(const vector<long long> &weights) {
+            long long total = 0;
+            for (long long weight : weights) {
+                total += weight;
+            }
+            long long target = between(0, total - 1);
+            for (size_t i = 0; i < weights.size(); i++) {
+                if (target < weights[i]) {
+                    return i;
+                }
+                target -= weights[i];
+            }
+            return weights.size() - 1;
+        }
+
+    private:
+        uint64_t state;
+};
+
+struct Distribution {
+    Distribution(bool skewed, int min, int max) : skewed(skewed), min(min), max(max) {}
+
+    int draw(Random &random) const {
+        long long value = random.between(min, max);
+        if (skewed) {
+            // The smaller of two draws: the chance of a value falls off linearly towards max.
+            value = std::min(value, random.between(min, max));
+        }
+        return static_cast<int>(value);
+    }
+
+    bool skewed;
+    int min;
+    int max;
+};
+
+enum Command {
+    STEP,
+    PLAN,
+    SETTLEMENT,
+    FACILITY,
+    PLAN_STATUS,
+    CHANGE_POLICY,
+    LOG,
+    BACKUP,
+    RESTORE,
+    STATS,
+    TOP,
+    AGGREGATE,
+    NUM_OF_COMMANDS,
+};
+
+static const char *COMMAND_NAMES[NUM_OF_COMMANDS] = {
+    "step", "plan", "settlement", "facility", "planStatus", "changePolicy", "log", "backup", "restore", "stats",
+    "top", "aggregate",
+};
+
+static const char *POLICY_NAMES[] = {"nve", "bal", "eco", "env"};
+static const char *METRIC_NAMES[] = {"lq", "eco", "env"};
+static const char *GROUPING_NAMES[] = {"settlement", "type", "policy"};
+static const int NUM_OF_POLICIES = 4;
+static const int NUM_OF_TYPES = static_cast<int>(SettlementType::METROPOLIS) + 1;
+static const int NUM_OF_CATEGORIES = static_cast<int>(FacilityCategory::ENVIRONMENT) + 1;
+
+struct Options {
+    Options()
+        : configPath(), scriptPath(), seed(1), numOfSettlements(100), typeWeights(NUM_OF_TYPES, 1),
+          catalogSizes(NUM_OF_CATEGORIES, 10), price(false, 1, 5), score(false, 0, 5),
+          plansPerPolicy(NUM_OF_POLICIES, 25), numOfCommands(1000), commandWeights(NUM_OF_COMMANDS, 0),
+          maxStep(10) {
+        commandWeights[STEP] = 20;
+        commandWeights[PLAN_STATUS] = 10;
+        commandWeights[CHANGE_POLICY] = 5;
+        commandWeights[PLAN] = 5;
+        commandWeights[SETTLEMENT] = 1;
+        commandWeights[FACILITY] = 1;
+    }
+
+    string configPath;
+    string scriptPath;
+    uint64_t seed;
+    long long numOfSettlements;
+    vector<long long> typeWeights;
+    vector<long long> catalogSizes;
+    Distribution price;
+    Distribution score;
+    vector<long long> plansPerPolicy;
+    long long numOfCommands;
+    vector<long long> commandWeights;
+    int maxStep;
+};
+
+static long long parseNumber(const string &text) {
+    if (text.empty() || text.find_first_not_of("0123456789") != string::npos) {
+        throw std::runtime_error("Not a non-negative number: " + text);
+    }
+    return std::strtoll(text.c_str(), nullptr, 10);
+}
+
+static vector<string> split(const string &text, char separator) {
+    vector<string> parts;
+    std::istringstream stream(text);
+    string part;
+    while (std::getline(stream, part, separator)) {
+        parts.push_back(part);
+    }
+    return parts;
+}
+
+static vector<long long> parseList(const string &text, size_t count, const string &flag) {
+    vector<string> parts = split(text, ':');
+    if (parts.size() != count) {
+        throw std::runtime_error(flag + " takes " + std::to_string(count) + " values separated by ':'");
+    }
+    vector<long long> values;
+    for (const string &part : parts) {
+        values.push_back(parseNumber(part));
+    }
+    return values;
+}
+
+static Distribution parseDistribution(const string &text, const string &flag) {
+    vector<string> parts = split(text, ':');
+    if (parts.size() != 3 || (parts[0] != "uniform" && parts[0] != "skewed")) {
+        throw std::runtime_error(flag + " takes uniform:MIN:MAX or skewed:MIN:MAX");
+    }
+    int min = static_cast<int>(parseNumber(parts[1]));
+    int max = static_cast<int>(parseNumber(parts[2]));
+    if (min > max) {
+        throw std::runtime_error(flag + ": MIN is larger than MAX");
+    }
+    return Distribution(parts[0] == "skewed", min, max);
+}
+
+static vector<long long> parseMix(const string &text) {
+    vector<long long> weights(NUM_OF_COMMANDS, 0);
+    for (const string &entry : split(text, ',')) {
+        size_t equals = entry.find('=');
+        string name = entry.substr(0, equals);
+        int command = 0;
+        while (command < NUM_OF_COMMANDS && name != COMMAND_NAMES[command]) {
+            command++;
+        }
+        if (equals == string::npos || command == NUM_OF_COMMANDS) {
+            throw std::runtime_error("--mix: unknown entry " + entry);
+        }
+        weights[command] = parseNumber(entry.substr(equals + 1));
+    }
+    return weights;
+}
+
+static long long sum(const vector<long long> &values) {
+    long long total = 0;
+    for (long long value : values) {
+        total += value;
+    }
+    return total;
+}
+
+static Options parseOptions(int argc, char **argv) {
+    Options options;
+    for (int i = 1; i < argc; i += 2) {
+        string flag = argv[i];
+        if (i + 1 >= argc) {
+            throw std::runtime_error(flag + " needs a value");
+        }
+        string value = argv[i + 1];
+        if (flag == "--config") {
+            options.configPath = value;
+        } else if (flag == "--script") {
+            options.scriptPath = value;
+        } else if (flag == "--seed") {
+            options.seed = static_cast<uint64_t>(parseNumber(value));
+        } else if (flag == "--settlements") {
+            options.numOfSettlements = parseNumber(value);
+        } else if (flag == "--types") {
+            options.typeWeights = parseList(value, NUM_OF_TYPES, flag);
+        } else if (flag == "--facilities") {
+            options.catalogSizes = parseList(value, NUM_OF_CATEGORIES, flag);
+        } else if (flag == "--price") {
+            options.price = parseDistribution(value, flag);
+        } else if (flag == "--score") {
+            options.score = parseDistribution(value, flag);
+        } else if (flag == "--plans") {
+            options.plansPerPolicy = parseList(value, NUM_OF_POLICIES, flag);
+        } else if (flag == "--commands") {
+            options.numOfCommands = parseNumber(value);
+        } else if (flag == "--mix") {
+            options.commandWeights = parseMix(value);
+        } else if (flag == "--max-step") {
+            options.maxStep = static_cast<int>(parseNumber(value));
+        } else {
+            throw std::runtime_error("Unknown option: " + flag);
+        }
+    }
+
+    if (options.configPath.empty()) {
+        throw std::runtime_error("--config is required");
+    }
+    if (options.numOfSettlements == 0 && sum(options.plansPerPolicy) > 0) {
+        throw std::runtime_error("Plans need at least one settlement");
+    }
+    if (sum(options.typeWeights) == 0) {
+        throw std::runtime_error("--types: at least one weight must be positive");
+    }
+    if (options.numOfCommands > 0 && sum(options.commandWeights) == 0) {
+        throw std::runtime_error("--mix: at least one weight must be positive");
+    }
+    if (options.price.min < 1) {
+        throw std::runtime_error("--price: prices start at 1");
+    }
+    if (options.maxStep < 1) {
+        throw std::runtime_error("--max-step must be at least 1");
+    }
+    return options;
+}
+
+/*
+Names are numbered in the order they are created, so the script can add more of
+them without clashing with the configuration. A restore takes the counts back to
+the last backup, along with the simulation.
+*/
+struct State {
+    State() : numOfSettlements(0), numOfFacilities(0), numOfPlans(0) {}
+    long long numOfSettlements;
+    long long numOfFacilities;
+    long long numOfPlans;
+};
+
+static void writeFacility(std::ostream &out, long long id, int category, const Options &options, Random &random) {
+    out << "facility F" << id << " " << category << " " << options.price.draw(random) << " "
+        << options.score.draw(random) << " " << options.score.draw(random) << " "
+        << options.score.draw(random) << "\n";
+}
+
+static void writeConfig(std::ostream &out, const Options &options, Random &random, State &state) {
+    for (; state.numOfSettlements < options.numOfSettlements; state.numOfSettlements++) {
+        out << "settlement S" << state.numOfSettlements << " " << random.pick(options.typeWeights) << "\n";
+    }
+
+    // Categories are interleaved in proportion to their sizes, as a real catalog would be.
+    vector<long long> remaining = options.catalogSizes;
+    for (long long left = sum(remaining); left > 0; left--) {
+        size_t category = random.pick(remaining);
+        remaining[category]--;
+        writeFacility(out, state.numOfFacilities++, static_cast<int>(category), options, random);
+    }
+
+    remaining = options.plansPerPolicy;
+    for (long long left = sum(remaining); left > 0; left--) {
+        size_t policy = random.pick(remaining);
+        remaining[policy]--;
+        out << "plan S" << random.between(0, state.numOfSettlements - 1) << " " << POLICY_NAMES[policy] << "\n";
+        state.numOfPlans++;
+    }
+}
+
+/*
+Commands are chosen by weight; a command that needs something the simulation doesn't
+have yet (a plan to look at, a settlement to plan for) is drawn again.
+*/
+static void writeScript(std::ostream &out, const Options &options, Random &random, State &state) {
+    State backedUp;
+    bool hasBackup = false;
+    long long written = 0;
+    while (written < options.numOfCommands) {
+        Command command = static_cast<Command>(random.pick(options.commandWeights));
+        if ((command == PLAN && state.numOfSettlements == 0) ||
+            ((command == PLAN_STATUS || command == CHANGE_POLICY) && state.numOfPlans == 0)) {
+            bool alwaysPossible = options.commandWeights[STEP] + options.commandWeights[SETTLEMENT] +
+                                  options.commandWeights[FACILITY] + options.commandWeights[LOG] +
+                                  options.commandWeights[BACKUP] + options.commandWeights[RESTORE] +
+                                  options.commandWeights[STATS] + options.commandWeights[TOP] +
+                                  options.commandWeights[AGGREGATE] > 0;
+            bool canAddPlan = options.commandWeights[PLAN] > 0 && state.numOfSettlements > 0;
+            if (!alwaysPossible && !canAddPlan) {
+                throw std::runtime_error("--mix: the commands chosen need plans or settlements, but none can be made");
+            }
+            continue;
+        }
+
+        switch (command) {
+            case STEP:
+                out << "step " << random.between(1, options.maxStep) << "\n";
+                break;
+            case PLAN:
+                out << "plan S" << random.between(0, state.numOfSettlements - 1) << " "
+                    << POLICY_NAMES[random.between(0, NUM_OF_POLICIES - 1)] << "\n";
+                state.numOfPlans++;
+                break;
+            case SETTLEMENT:
+                out << "settlement S" << state.numOfSettlements++ << " " << random.pick(options.typeWeights) << "\n";
+                break;
+            case FACILITY:
+                writeFacility(out, state.numOfFacilities++, static_cast<int>(random.between(0, NUM_OF_CATEGORIES - 1)),
+                              options, random);
+                break;
+            case PLAN_STATUS:
+                out << "planStatus " << random.between(0, state.numOfPlans - 1) << "\n";
+                break;
+            case CHANGE_POLICY:
+                out << "changePolicy " << random.between(0, state.numOfPlans - 1) << " "
+                    << POLICY_NAMES[random.between(0, NUM_OF_POLICIES - 1)] << "\n";
+                break;
+            case BACKUP:
+                out << "backup\n";
+                backedUp = state;
+                hasBackup = true;
+                break;
+            case RESTORE:
+                out << "restore\n";
+                if (hasBackup) {
+                    state = backedUp;
+                }
+                break;
+            case TOP:
+                out << "top " << METRIC_NAMES[random.between(0, 2)] << " " << random.between(1, 10) << "\n";
+                break;
+            case AGGREGATE:
+                out << "aggregate " << METRIC_NAMES[random.between(0, 2)] << " by " << GROUPING_NAMES[random.between(0, 2)] << "\n";
+                break;
+            default:
+                out << COMMAND_NAMES[command] << "\n";
+                break;
+        }
+        written++;
+    }
+    out << "close\n";
+}
+
+static void writeFile(const string &path, const std::function<void(std::ostream&)> &write) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file for writing: " + path);
+    }
+    write(file);
+    if (!file) {
+        throw std::runtime_error("Failed to write file: " + path);
+    }
+}
+
+int main(int argc, char **argv) {
+    try {
+        Options options = parseOptions(argc, argv);
+        Random random(options.seed);
+        State state;
+        writeFile(options.configPath, [&](std::ostream &out) { writeConfig(out, options, random, state); });
+        if (!options.scriptPath.empty()) {
+            writeFile(options.scriptPath, [&](std::ostream &out) { writeScript(out, options, random, state); });
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "generate: " << e.what() << "\n";
+        std::cerr << "usage: generate --config FILE [--script FILE] [--seed N] [--settlements N] [--types V:C:M]\n"
+                     "       [--facilities LQ:ECO:ENV] [--price DIST:MIN:MAX] [--score DIST:MIN:MAX]\n"
+                     "       [--plans NVE:BAL:ECO:ENV] [--commands N] [--mix NAME=W,...] [--max-step N]\n";
+        return 1;
+    }
+    return 0;
+}